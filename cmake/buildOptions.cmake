@@ -35,11 +35,6 @@ if(DEFINED VOLE_PSI_PIC)
     unset(VOLE_PSI_PIC CACHE)
 endif()
 
-#option(FETCH_SPARSEHASH		"download and build sparsehash" OFF))
-EVAL(FETCH_SPARSEHASH_AUTO 
-	(DEFINED FETCH_SPARSEHASH AND FETCH_SPARSEHASH) OR
-	((NOT DEFINED FETCH_SPARSEHASH) AND (FETCH_AUTO)))
-
 #option(FETCH_LIBOTE		"download and build libOTe" OFF))
 EVAL(FETCH_LIBOTE_AUTO 
 	(DEFINED FETCH_LIBOTE AND FETCH_LIBOTE) OR
@@ -97,7 +92,6 @@ message(STATUS "vole-psi options\n==============================================
 message(STATUS "Option: VOLE_PSI_NO_SYSTEM_PATH    = ${VOLE_PSI_NO_SYSTEM_PATH}")
 message(STATUS "Option: CMAKE_BUILD_TYPE           = ${CMAKE_BUILD_TYPE}\n")
 message(STATUS "Option: FETCH_AUTO                 = ${FETCH_AUTO}")
-message(STATUS "Option: FETCH_SPARSEHASH           = ${FETCH_SPARSEHASH}")
 message(STATUS "Option: FETCH_LIBOTE               = ${FETCH_LIBOTE}")
 
 
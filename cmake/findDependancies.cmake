@@ -7,44 +7,6 @@ set(PUSHED_CMAKE_PREFIX_PATH ${CMAKE_PREFIX_PATH})
 set(CMAKE_PREFIX_PATH "${VOLEPSI_THIRDPARTY_DIR};${CMAKE_PREFIX_PATH}")
 
 
-#######################################
-# sparsehash
-
-macro(FIND_SPARSEHASH)
-    set(ARGS ${ARGN})
-
-    #explicitly asked to fetch sparsehash
-    if(FETCH_SPARSEHASH)
-        list(APPEND ARGS NO_DEFAULT_PATH PATHS ${VOLEPSI_THIRDPARTY_DIR})
-    elseif(${NO_CMAKE_SYSTEM_PATH})
-        list(APPEND ARGS NO_CMAKE_SYSTEM_PATH)
-    endif()
-    
-    find_path(SPARSEHASH_INCLUDE_DIRS "sparsehash/dense_hash_map" PATH_SUFFIXES "include" ${ARGS})
-
-    if(EXISTS ${SPARSEHASH_INCLUDE_DIRS})
-        set(SPARSEHASH_FOUND ON)
-    else()
-        set(SPARSEHASH_FOUND OFF)
-    endif()
-endmacro()
-
-if(FETCH_SPARSEHASH_AUTO)
-    FIND_SPARSEHASH(QUIET)
-    include(${CMAKE_CURRENT_LIST_DIR}/../thirdparty/getSparsehash.cmake)
-endif()
-
-FIND_SPARSEHASH(REQUIRED)
-message("SPARSEHASH_INCLUDE_DIRS=${SPARSEHASH_INCLUDE_DIRS}")
-
-if(NOT TARGET sparsehash)
-    add_library(sparsehash INTERFACE IMPORTED)
-    
-    target_include_directories(sparsehash INTERFACE 
-                    $<BUILD_INTERFACE:${SPARSEHASH_INCLUDE_DIRS}>
-                    $<INSTALL_INTERFACE:>)
-endif()
-
 #######################################
 # libOTe
 
@@ -60,7 +60,12 @@ int main(int argc, char** argv)
             << "   -malicious: run the protocol with malicious security\n"
             << "   -useSilver: run the protocol with the Silver Vole encoder (experimental, default is expand accumulate)\n"
             << "   -useQC: run the protocol with the QuasiCyclic Vole encoder (default is expand accumulate)\n"
-            << "   -ssp: Statistical Security parameter, default = 40.\n\n"
+            << "   -ssp: Statistical Security parameter, default = 40.\n"
+            << "   -sessions <value>: the sender accepts this many connections and runs a PSI session with each, sharing its set.\n"
+            << "                      The sender is then always the IP server and the receivers must set -server 0.\n"
+            << "   -maxSessions <value>: the number of sessions that run at the same time. (Default = sessions)\n"
+            << "   -maxRecverSize <value>: with -sessions, receivers with larger sets are rejected. (Default = 2^24)\n"
+            << "   -nt <value>: with -sessions, the number of threads of each session. (Default = 1)\n\n"
 
             << "   -ip <value>: IP address and port of the server = PSI receiver. (Default = localhost:1212)\n"
             << "   -server <value>: Value should be in {0, 1} and indicates if this party should be the IP server. (Default = r)\n"
@@ -97,6 +102,10 @@ int main(int argc, char** argv)
             << "      -useSilver: run the protocol with the Silver Vole encoder (experimental, default is expand accumulate)\n"
             << "      -useQC: run the protocol with the QuasiCyclic Vole encoder (default is expand accumulate)\n"
             << "      -bs: the okvs bin size.\n"
+            << "      -hash: intersect with a hash table (default).\n"
+            << "      -sortMerge: intersect by sorting both sets and merging.\n"
+            << "      -encode: compress the sender's hashes.\n"
+            << "      -cardinality: only output the intersection size.\n"
             << "   -cpsi: Run the circuit psi benchmark.\n"
             << "      -nn <value>: the log2 size of the sets.\n"
             << "      -t <value>: the number of trials.\n"
@@ -408,6 +408,20 @@ void perfPSI(oc::CLP& cmd)
 		send.mSender.mBinSize = binSize;
 	}
 
+	if (cmd.isSet("hash"))
+		recv.mIntersectType = PsiIntersectType::Hash;
+	if (cmd.isSet("sortMerge"))
+		recv.mIntersectType = PsiIntersectType::SortMerge;
+
+	if (cmd.isSet("encode"))
+	{
+		recv.mEncodeHashes = true;
+		send.mEncodeHashes = true;
+	}
+
+	if (cmd.isSet("cardinality"))
+		recv.mOutput = PsiOutput::Cardinality;
+
 	std::vector<block> recvSet(n), sendSet(n);
 	prng.get<block>(recvSet);
 	prng.get<block>(sendSet);
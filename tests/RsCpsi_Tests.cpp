@@ -26,12 +26,23 @@ namespace
         RsCpsiReceiver recver;
         RsCpsiSender sender;
 
+        // the value of each item is the item, with the
+        // words reduced mod the modulus for modP.
+        u64 modulus = (1ull << 61) - 1;
+        auto value = [&](block v) {
+            if (type == ValueShareType::modP)
+                v = block(v.get<u64>(1) % modulus, v.get<u64>(0) % modulus);
+            return v;
+        };
+
         auto byteLength = sizeof(block);
         oc::Matrix<u8> senderValues(sendSet.size(), sizeof(block));
-        std::memcpy(senderValues.data(), sendSet.data(), sendSet.size() * sizeof(block));
+        for (u64 i = 0; i < sendSet.size(); ++i)
+            *(block*)&senderValues(i, 0) = value(sendSet[i]);
 
-        recver.init(sendSet.size(), recvSet.size(), byteLength, 40, prng.get(), nt);
-        sender.init(sendSet.size(), recvSet.size(), byteLength, 40, prng.get(), nt);
+        recver.init(sendSet.size(), recvSet.size(), byteLength, 40, prng.get(), nt, type);
+        sender.init(sendSet.size(), recvSet.size(), byteLength, 40, prng.get(), nt, type);
+        recver.mModulus = sender.mModulus = modulus;
 
         RsCpsiReceiver::Sharing rShare;
         RsCpsiSender::Sharing sShare;
@@ -64,18 +75,33 @@ namespace
                         //throw RTE_LOC;
                     }
                 }
-                else
+                else if (type == ValueShareType::add32)
                 {
-
+                    auto rv = (u32*)&rShare.mValues(k, 0);
+                    auto sv = (u32*)&sShare.mValues(k, 0);
                     for (u64 j = 0; j < 4; ++j)
                     {
-                        auto rv = (u32*)&rShare.mValues(i, 0);
-                        auto sv = (u32*)&sShare.mValues(i, 0);
-
-                        if (recvSet[i].get<u32>(j) != (sv[j] + rv[j]))
-                        {
+                        if (recvSet[i].get<u32>(j) != u32(sv[j] + rv[j]))
                             throw RTE_LOC;
+                    }
+                }
+                else
+                {
+                    auto exp = value(recvSet[i]);
+                    auto rv = (u64*)&rShare.mValues(k, 0);
+                    auto sv = (u64*)&sShare.mValues(k, 0);
+                    for (u64 j = 0; j < 2; ++j)
+                    {
+                        auto act = sv[j] + rv[j];
+                        if (type == ValueShareType::modP)
+                        {
+                            if (sv[j] >= modulus || rv[j] >= modulus)
+                                throw RTE_LOC;
+                            act = act % modulus;
                         }
+
+                        if (exp.get<u64>(j) != act)
+                            throw RTE_LOC;
                     }
                 }
             }
@@ -140,6 +166,32 @@ void Cpsi_Rs_partial_test(const CLP& cmd)
 }
 
 
+void Cpsi_Rs_partial_mt_test(const CLP& cmd)
+{
+    // large enough that the sender's simple hashing is split between the threads.
+    u64 n = cmd.getOr("n", 20000);
+    u64 nt = cmd.getOr("nt", 4);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    auto inter = runCpsi(prng, recvSet, sendSet, nt);
+    std::set<u64> act(inter.begin(), inter.end());
+    if (act != exp)
+        throw RTE_LOC;
+}
+
 void Cpsi_Rs_full_test(const CLP& cmd)
 {
     u64 n = cmd.getOr("n", 243);
@@ -181,20 +233,269 @@ void Cpsi_Rs_full_asym_test(const CLP& cmd)
 
 
 
+namespace
+{
+    void fullShareTypeTest(const CLP& cmd, ValueShareType type)
+    {
+        u64 n = cmd.getOr("n", 13243);
+        std::vector<block> recvSet(n), sendSet(n);
+        PRNG prng(ZeroBlock);
+        prng.get(recvSet.data(), recvSet.size());
+        sendSet = recvSet;
+
+        std::set<u64> exp;
+        for (u64 i = 0; i < n; ++i)
+            exp.insert(i);
+
+        auto inter = runCpsi(prng, recvSet, sendSet, 1, type);
+        std::set<u64> act(inter.begin(), inter.end());
+        if (act != exp)
+            throw RTE_LOC;
+    }
+}
+
 void Cpsi_Rs_full_add32_test(const CLP& cmd)
 {
-    //u64 n = cmd.getOr("n", 13243);
-    //std::vector<block> recvSet(n), sendSet(n);
-    //PRNG prng(ZeroBlock);
-    //prng.get(recvSet.data(), recvSet.size());
-    //sendSet = recvSet;
-
-    //std::set<u64> exp;
-    //for (u64 i = 0; i < n; ++i)
-    //    exp.insert(i);
-
-    //auto inter = runCpsi(prng, recvSet, sendSet, 1, ValueShareType::add32);
-    //std::set<u64> act(inter.begin(), inter.end());
-    //if (act != exp)
-    //    throw RTE_LOC;
-}
\ No newline at end of file
+    fullShareTypeTest(cmd, ValueShareType::add32);
+}
+
+void Cpsi_Rs_full_add64_test(const CLP& cmd)
+{
+    fullShareTypeTest(cmd, ValueShareType::add64);
+}
+
+void Cpsi_Rs_full_modp_test(const CLP& cmd)
+{
+    fullShareTypeTest(cmd, ValueShareType::modP);
+}
+
+void Cpsi_Rs_aggregate_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 1000);
+    u64 nt = cmd.getOr("nt", 1);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    // the sender item matching the i'th receiver item, if any.
+    std::vector<u64> match(n, ~0ull);
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            match[i] = (i + 312) % n;
+            recvSet[i] = sendSet[match[i]];
+        }
+    }
+
+    for (u64 numCategories : { 0, 3 })
+    {
+        // the amount and the category of each sender item.
+        Matrix<u32> values(n, 2);
+        prng.get<u32>(values);
+        for (u64 i = 0; numCategories && i < n; ++i)
+            values(i, 1) %= numCategories;
+
+        std::vector<u32> exp(2 + 2 * numCategories);
+        for (u64 i = 0; i < n; ++i)
+        {
+            if (match[i] == ~0ull)
+                continue;
+
+            auto v = values(match[i], 0);
+            ++exp[0];
+            exp[1] += v;
+
+            if (numCategories)
+            {
+                auto g = values(match[i], 1);
+                ++exp[2 + 2 * g];
+                exp[3 + 2 * g] += v;
+            }
+        }
+
+        auto sockets = LocalAsyncSocket::makePair();
+        RsCpsiReceiver recver;
+        RsCpsiSender sender;
+
+        recver.init(n, n, values.cols() * sizeof(u32), 40, prng.get(), nt, ValueShareType::add32);
+        sender.init(n, n, values.cols() * sizeof(u32), 40, prng.get(), nt, ValueShareType::add32);
+        recver.mAggregate = sender.mAggregate = true;
+        recver.mNumCategories = sender.mNumCategories = numCategories;
+
+        RsCpsiReceiver::Sharing rShare;
+        RsCpsiSender::Sharing sShare;
+
+        auto p0 = recver.receive(recvSet, rShare, sockets[0]);
+        auto p1 = sender.send(sendSet, MatrixView<u8>((u8*)values.data(), n, values.cols() * sizeof(u32)), sShare, sockets[1]);
+        eval(p0, p1);
+
+        if (rShare.mAggregates.size() != exp.size() ||
+            sShare.mAggregates.size() != exp.size())
+            throw RTE_LOC;
+
+        for (u64 k = 0; k < exp.size(); ++k)
+        {
+            if (u32(rShare.mAggregates[k] + sShare.mAggregates[k]) != exp[k])
+                throw RTE_LOC;
+        }
+    }
+}
+
+void Cpsi_Rs_compact_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 500);
+    u64 bound = cmd.getOr("bound", 64);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n && exp.size() < bound / 2; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    auto sockets = LocalAsyncSocket::makePair();
+    RsCpsiReceiver recver;
+    RsCpsiSender sender;
+
+    // the value of each sender item is the item.
+    oc::MatrixView<u8> senderValues((u8*)sendSet.data(), n, sizeof(block));
+    recver.init(n, n, sizeof(block), 40, prng.get(), 1);
+    sender.init(n, n, sizeof(block), 40, prng.get(), 1);
+    recver.mCompactBound = sender.mCompactBound = bound;
+
+    RsCpsiReceiver::Sharing rShare;
+    RsCpsiSender::Sharing sShare;
+
+    auto p0 = recver.receive(recvSet, rShare, sockets[0]);
+    auto p1 = sender.send(sendSet, senderValues, sShare, sockets[1]);
+    eval(p0, p1);
+
+    if (rShare.mFlagBits.size() != bound ||
+        sShare.mFlagBits.size() != bound ||
+        rShare.mValues.rows() != bound ||
+        rShare.mRecverIdx.size() != bound)
+        throw RTE_LOC;
+
+    // the intersection is in the first rows.
+    std::set<u64> act;
+    for (u64 i = 0; i < bound; ++i)
+    {
+        if (rShare.mFlagBits[i] ^ sShare.mFlagBits[i])
+        {
+            if (i != act.size())
+                throw RTE_LOC;
+
+            auto idx = rShare.mRecverIdx[i] ^ sShare.mRecverIdx[i];
+            auto v = *(block*)&rShare.mValues(i, 0) ^ *(block*)&sShare.mValues(i, 0);
+            if (idx >= n || recvSet[idx] != v)
+                throw RTE_LOC;
+
+            act.insert(idx);
+        }
+    }
+
+    if (act != exp)
+        throw RTE_LOC;
+}
+
+void Cpsi_Rs_chunked_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 3000);
+    u64 chunkSize = cmd.getOr("chunk", 1000);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    // the value of each sender item is the item.
+    oc::MatrixView<u8> senderValues((u8*)sendSet.data(), n, sizeof(block));
+
+    for (bool callback : { false, true })
+    {
+        auto sockets = LocalAsyncSocket::makePair();
+        RsCpsiReceiver recver;
+        RsCpsiSender sender;
+
+        recver.init(n, n, sizeof(block), 40, prng.get(), 1);
+        sender.init(n, n, sizeof(block), 40, prng.get(), 1);
+        recver.mChunkSize = sender.mChunkSize = chunkSize;
+
+        RsCpsiReceiver::Sharing rShare;
+        RsCpsiSender::Sharing sShare;
+
+        // with the callback, the chunks are collected here.
+        std::vector<std::pair<u64, RsCpsiReceiver::Sharing>> rChunks;
+        std::vector<std::pair<u64, RsCpsiSender::Sharing>> sChunks;
+        if (callback)
+        {
+            recver.mChunkCallback = [&](u64 b, RsCpsiReceiver::Sharing& c) { rChunks.emplace_back(b, std::move(c)); };
+            sender.mChunkCallback = [&](u64 b, RsCpsiSender::Sharing& c) { sChunks.emplace_back(b, std::move(c)); };
+        }
+
+        auto p0 = recver.receive(recvSet, rShare, sockets[0]);
+        auto p1 = sender.send(sendSet, senderValues, sShare, sockets[1]);
+        eval(p0, p1);
+
+        if (callback)
+        {
+            if (rChunks.size() < 2 || rChunks.size() != sChunks.size())
+                throw RTE_LOC;
+
+            // reassemble the chunks.
+            u64 numBins = rChunks.back().first + rChunks.back().second.mFlagBits.size();
+            rShare.mFlagBits.resize(numBins);
+            sShare.mFlagBits.resize(numBins);
+            rShare.mValues.resize(numBins, sizeof(block));
+            sShare.mValues.resize(numBins, sizeof(block));
+            for (u64 c = 0; c < rChunks.size(); ++c)
+            {
+                if (rChunks[c].first != sChunks[c].first)
+                    throw RTE_LOC;
+
+                auto begin = rChunks[c].first;
+                for (u64 i = 0; i < rChunks[c].second.mFlagBits.size(); ++i)
+                {
+                    rShare.mFlagBits[begin + i] = rChunks[c].second.mFlagBits[i];
+                    sShare.mFlagBits[begin + i] = sChunks[c].second.mFlagBits[i];
+                    std::memcpy(&rShare.mValues(begin + i, 0), &rChunks[c].second.mValues(i, 0), sizeof(block));
+                    std::memcpy(&sShare.mValues(begin + i, 0), &sChunks[c].second.mValues(i, 0), sizeof(block));
+                }
+            }
+        }
+
+        std::set<u64> act;
+        for (u64 i = 0; i < n; ++i)
+        {
+            auto k = rShare.mMapping[i];
+            if (rShare.mFlagBits[k] ^ sShare.mFlagBits[k])
+            {
+                auto v = *(block*)&rShare.mValues(k, 0) ^ *(block*)&sShare.mValues(k, 0);
+                if (v != recvSet[i])
+                    throw RTE_LOC;
+                act.insert(i);
+            }
+        }
+
+        if (act != exp)
+            throw RTE_LOC;
+    }
+}
@@ -11,6 +11,12 @@
 
 void Cpsi_Rs_empty_test(const oc::CLP&);
 void Cpsi_Rs_partial_test(const oc::CLP&);
+void Cpsi_Rs_partial_mt_test(const oc::CLP&);
 void Cpsi_Rs_full_test(const oc::CLP&);
 void Cpsi_Rs_full_asym_test(const oc::CLP&);
 void Cpsi_Rs_full_add32_test(const oc::CLP&);
+void Cpsi_Rs_full_add64_test(const oc::CLP&);
+void Cpsi_Rs_full_modp_test(const oc::CLP&);
+void Cpsi_Rs_aggregate_test(const oc::CLP&);
+void Cpsi_Rs_compact_test(const oc::CLP&);
+void Cpsi_Rs_chunked_test(const oc::CLP&);
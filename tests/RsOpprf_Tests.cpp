@@ -1,6 +1,7 @@
 #include "RsOpprf_Tests.h"
 #include "volePSI/RsOprf.h"
 #include "volePSI/RsOpprf.h"
+#include "volePSI/RsLabeledPsi.h"
 #include "cryptoTools/Network/Channel.h"
 #include "cryptoTools/Network/Session.h"
 #include "cryptoTools/Network/IOService.h"
@@ -195,3 +196,97 @@ void RsOpprf_eval_u8_mtx_test(const CLP&)
     if (count)
         throw RTE_LOC;
 }
+
+void RsOpprf_eval_mt_test(const CLP& cmd)
+{
+    RsOpprfSender sender;
+    RsOpprfReceiver recver;
+
+    auto sockets = cp::LocalAsyncSocket::makePair();
+
+    // the thread ranges are not multiples of 8, so some items are expanded
+    // with a single key by the sender and in a MultiKeyAES batch by the receiver.
+    u64 n = cmd.getOr("n", 20003);
+    u64 m = cmd.getOr("m", 20);
+    u64 nt = cmd.getOr("nt", 3);
+    PRNG prng0(block(0, 0));
+    PRNG prng1(block(0, 1));
+
+    std::vector<block> vals(n);
+    oc::Matrix<u8> out(n, m), out1(n, m), out2(n, m), recvOut(n, m);
+
+    prng0.get(vals.data(), n);
+    prng0.get(out.data(), out.size());
+
+    auto p0 = sender.send(n, vals, out, prng0, nt, sockets[0]);
+    auto p1 = recver.receive(n, vals, recvOut, prng1, nt, sockets[1]);
+
+    eval(p0, p1);
+
+    sender.eval(vals, out1, 1);
+    sender.eval(vals, out2, nt);
+
+    u64 count = 0;
+    for (u64 i = 0; i < n; ++i)
+    {
+        auto c0 = memcmp(recvOut[i].data(), out[i].data(), m) != 0;
+        auto c1 = memcmp(recvOut[i].data(), out1[i].data(), m) != 0;
+        auto c2 = memcmp(recvOut[i].data(), out2[i].data(), m) != 0;
+        if (c0 || c1 || c2)
+        {
+            if (count < 10)
+                std::cout << i << " " << hex(recvOut[i]) << " " << hex(out1[i]) << " " << hex(out2[i]) << " " << hex(out[i]) << std::endl;
+            else
+                break;
+
+            ++count;
+        }
+    }
+    if (count)
+        throw RTE_LOC;
+}
+
+void Psi_RsLabeled_test(const CLP& cmd)
+{
+    u64 ns = cmd.getOr("ns", 3000);
+    u64 nr = cmd.getOr("nr", 2000);
+    u64 labelSize = cmd.getOr("labelSize", 21);
+    PRNG prng(block(0, 2));
+
+    std::vector<block> sendSet(ns), recvSet(nr);
+    oc::Matrix<u8> labels(ns, labelSize);
+    prng.get(sendSet.data(), ns);
+    prng.get(recvSet.data(), nr);
+    prng.get(labels.data(), labels.size());
+
+    std::vector<u64> exp, expIdx;
+    for (u64 i = 0; i < nr; ++i)
+    {
+        if (prng.getBit())
+        {
+            auto j = (i * 3 + 17) % ns;
+            recvSet[i] = sendSet[j];
+            exp.push_back(i);
+            expIdx.push_back(j);
+        }
+    }
+
+    RsLabeledPsiSender sender;
+    RsLabeledPsiReceiver recver;
+    sender.init(ns, nr, labelSize, 40, prng.get(), 1);
+    recver.init(ns, nr, labelSize, 40, prng.get(), 1);
+
+    auto sockets = cp::LocalAsyncSocket::makePair();
+    auto p0 = sender.run(sendSet, labels, sockets[0]);
+    auto p1 = recver.run(recvSet, sockets[1]);
+    eval(p0, p1);
+
+    if (recver.mIntersection != exp)
+        throw RTE_LOC;
+
+    for (u64 i = 0; i < exp.size(); ++i)
+    {
+        if (memcmp(recver.mLabels[i].data(), labels[expIdx[i]].data(), labelSize))
+            throw RTE_LOC;
+    }
+}
@@ -18,4 +18,7 @@ void RsOpprf_eval_blk_mtx_test(const oc::CLP&);
 
 void RsOpprf_eval_u8_test(const oc::CLP&);
 void RsOpprf_eval_u8_mtx_test(const oc::CLP&);
+void RsOpprf_eval_mt_test(const oc::CLP&);
+
+void Psi_RsLabeled_test(const oc::CLP&);
 #endif
\ No newline at end of file
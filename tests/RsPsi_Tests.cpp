@@ -1,22 +1,33 @@
 #include "RsPsi_Tests.h"
 #include "volePSI/RsPsi.h"
 #include "volePSI/RsCpsi.h"
+#include "volePSI/SimdHashTable.h"
+#include "volePSI/ShardedPsi.h"
+#include "volePSI/RsPsiServer.h"
+#include "volePSI/HashCodec.h"
 #include "cryptoTools/Network/Channel.h"
 #include "cryptoTools/Network/Session.h"
 #include "cryptoTools/Network/IOService.h"
 #include "Common.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <set>
+#include <thread>
 using namespace oc;
 using namespace volePSI;
 using coproto::LocalAsyncSocket;
 
 namespace
 {
-    std::vector<u64> run(PRNG& prng, std::vector<block>& recvSet, std::vector<block> &sendSet, bool mal, u64 nt = 1, bool reduced = false)
+    std::vector<u64> run(PRNG& prng, std::vector<block>& recvSet, std::vector<block> &sendSet, bool mal, u64 nt = 1, bool reduced = false,
+        PsiIntersectType type = PsiIntersectType::Auto)
     {
         auto sockets = LocalAsyncSocket::makePair();
 
         RsPsiReceiver recver;
         RsPsiSender sender;
+        recver.mIntersectType = type;
 
         recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, nt, reduced);
         sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, nt, reduced);
@@ -158,3 +169,697 @@ void Psi_Rs_mal_test(const CLP& cmd)
     if (act != exp)
         throw RTE_LOC;
 }
+
+
+namespace
+{
+    template<typename Key, typename Value>
+    void simdHashTableTest(u64 n, PRNG& prng)
+    {
+        std::vector<Key> keys(n), other(n);
+        std::vector<Value> values(n);
+        prng.get(keys.data(), keys.size());
+        prng.get(other.data(), other.size());
+        for (u64 i = 0; i < n; ++i)
+            values[i] = i;
+
+        SimdHashTable<Key, Value> table;
+        table.init(n);
+        table.insert(span<const Key>(keys).subspan(0, n / 2), span<const Value>(values).subspan(0, n / 2));
+        for (u64 i = n / 2; i < n; ++i)
+            table.insert(keys[i], values[i]);
+
+        if (table.size() != n)
+            throw RTE_LOC;
+
+        for (u64 i = 0; i < n; ++i)
+        {
+            if (table.find(keys[i]) != i)
+                throw RTE_LOC;
+            if (table.find(other[i]) != table.npos)
+                throw RTE_LOC;
+        }
+
+        std::vector<u64> hits;
+        table.find(span<const Key>(keys), [&](u64 i, Value v) {
+            if (v != i)
+                throw RTE_LOC;
+            hits.push_back(i);
+            });
+        if (hits.size() != n)
+            throw RTE_LOC;
+
+        table.find(span<const Key>(other), [&](u64, Value) {
+            throw RTE_LOC;
+            });
+
+        bool threw = false;
+        try { table.insert(other[0], 0); }
+        catch (...) { threw = true; }
+        if (!threw)
+            throw RTE_LOC;
+    }
+}
+
+void Psi_SimdHashTable_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    PRNG prng(ZeroBlock);
+    simdHashTableTest<u64, u32>(n, prng);
+    simdHashTableTest<u64, u64>(n, prng);
+    simdHashTableTest<block, u32>(n, prng);
+    simdHashTableTest<block, u64>(n, prng);
+    simdHashTableTest<u64, u32>(1, prng);
+}
+
+void Psi_Rs_smallMask_test(const CLP& cmd)
+{
+    // small sets so that the truncated hashes fit in a u64.
+    u64 n = cmd.getOr("n", 1000);
+    u64 nt = cmd.getOr("nt", 4);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    for (auto t : std::vector<u64>{ 1, nt })
+    {
+        auto inter = run(prng, recvSet, sendSet, false, t);
+        std::set<u64> act(inter.begin(), inter.end());
+        if (act != exp)
+            throw RTE_LOC;
+    }
+}
+
+void Psi_Rs_sortMerge_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 nt = cmd.getOr("nt", 4);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    for (auto mal : { false, true })
+    {
+        for (auto t : std::vector<u64>{ 1, nt })
+        {
+            auto inter = run(prng, recvSet, sendSet, mal, t, false, PsiIntersectType::SortMerge);
+            std::set<u64> act(inter.begin(), inter.end());
+            if (act != exp)
+                throw RTE_LOC;
+        }
+    }
+}
+
+void Psi_Rs_chunked_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 nt = cmd.getOr("nt", 4);
+    u64 chunkSize = cmd.getOr("chunk", 1000);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    for (auto encode : { false, true })
+    {
+        for (auto type : { PsiIntersectType::Hash, PsiIntersectType::SortMerge })
+        {
+            for (auto t : std::vector<u64>{ 1, nt })
+            {
+                auto sockets = LocalAsyncSocket::makePair();
+
+                RsPsiReceiver recver;
+                RsPsiSender sender;
+
+                recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+                sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+                recver.mIntersectType = type;
+                recver.mHashChunkSize = chunkSize;
+                sender.mHashChunkSize = chunkSize;
+                recver.mEncodeHashes = encode;
+                sender.mEncodeHashes = encode;
+
+                auto p0 = recver.run(recvSet, sockets[0]);
+                auto p1 = sender.run(sendSet, sockets[1]);
+
+                eval(p0, p1);
+
+                std::set<u64> act(recver.mIntersection.begin(), recver.mIntersection.end());
+                if (act != exp)
+                    throw RTE_LOC;
+            }
+        }
+    }
+
+    // both parties detect different settings.
+    {
+        auto sockets = LocalAsyncSocket::makePair();
+
+        RsPsiReceiver recver;
+        RsPsiSender sender;
+
+        recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, 1);
+        sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, 1);
+        recver.mHashChunkSize = chunkSize;
+        sender.mHashChunkSize = chunkSize + 1;
+
+        auto r = macoro::sync_wait(macoro::when_all_ready(
+            recver.run(recvSet, sockets[0]),
+            sender.run(sendSet, sockets[1])));
+
+        auto failed = [](auto& res) {
+            try { res.result(); }
+            catch (std::runtime_error&) { return true; }
+            return false;
+        };
+
+        if (!failed(std::get<0>(r)) || !failed(std::get<1>(r)))
+            throw RTE_LOC;
+    }
+}
+
+void Psi_Rs_hashCodec_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    std::vector<block> hashes(n);
+    PRNG prng(ZeroBlock);
+    prng.get(hashes.data(), hashes.size());
+
+    for (u64 maskSize : { 6, 8, 10, 16 })
+    {
+        HashCodec codec;
+        codec.init(n, maskSize);
+
+        // the unary part is n + 2^h <= 2n bits, so at least h - 2 bits
+        // are saved per hash. For n = 13243 it is 11.4 of maskSize * 8.
+        // Each of the two parts is rounded up to whole words.
+        auto h = log2floor(n);
+        auto bits = codec.encodedSize() * 64;
+        if (bits > n * (maskSize * 8 - (h - 2)) + 128)
+            throw RTE_LOC;
+        if (cmd.isSet("v"))
+            std::cout << "maskSize " << maskSize << " encoded bits per hash "
+                << double(bits) / n << " of " << maskSize * 8 << std::endl;
+
+        std::vector<u64> encoded(codec.encodedSize());
+        codec.encode(hashes, encoded);
+
+        Matrix<u8> decoded(n, maskSize);
+        codec.decode(encoded, decoded);
+
+        // the order is not kept.
+        std::multiset<std::vector<u8>> exp, act;
+        for (u64 i = 0; i < n; ++i)
+        {
+            exp.emplace((u8*)&hashes[i], (u8*)&hashes[i] + maskSize);
+            act.emplace(decoded[i].begin(), decoded[i].end());
+        }
+        if (exp != act)
+            throw RTE_LOC;
+    }
+}
+
+void Psi_Rs_cardinality_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 nt = cmd.getOr("nt", 4);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    u64 exp = 0;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            ++exp;
+        }
+    }
+
+    for (auto type : { PsiIntersectType::Hash, PsiIntersectType::SortMerge })
+    {
+        for (auto t : std::vector<u64>{ 1, nt })
+        {
+            auto sockets = LocalAsyncSocket::makePair();
+
+            RsPsiReceiver recver;
+            RsPsiSender sender;
+
+            recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+            sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+            recver.mIntersectType = type;
+            recver.mOutput = PsiOutput::Cardinality;
+
+            auto p0 = recver.run(recvSet, sockets[0]);
+            auto p1 = sender.run(sendSet, sockets[1]);
+
+            eval(p0, p1);
+
+            if (recver.mCardinality != exp || recver.mIntersection.size())
+                throw RTE_LOC;
+        }
+    }
+}
+
+void Psi_Rs_bitmap_test(const CLP& cmd)
+{
+    u64 nt = cmd.getOr("nt", 4);
+
+    // 100 items is 13 bytes, the bitmap's last word is partial.
+    for (u64 n : { cmd.getOr<u64>("n", 13243), u64(100) })
+    {
+        std::vector<block> recvSet(n), sendSet(n);
+        PRNG prng(ZeroBlock);
+        prng.get(recvSet.data(), recvSet.size());
+        prng.get(sendSet.data(), sendSet.size());
+
+        std::vector<u64> exp;
+        for (u64 i = 0; i < n; ++i)
+        {
+            if (prng.getBit())
+            {
+                recvSet[i] = sendSet[(i + 312) % n];
+                exp.push_back(i);
+            }
+        }
+
+        for (auto type : { PsiIntersectType::Hash, PsiIntersectType::SortMerge })
+        {
+            for (auto t : std::vector<u64>{ 1, nt })
+            {
+                auto sockets = LocalAsyncSocket::makePair();
+
+                RsPsiReceiver recver;
+                RsPsiSender sender;
+
+                recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+                sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), false, t);
+                recver.mIntersectType = type;
+                recver.mOutput = PsiOutput::Bitmap;
+
+                auto p0 = recver.run(recvSet, sockets[0]);
+                auto p1 = sender.run(sendSet, sockets[1]);
+
+                eval(p0, p1);
+
+                std::vector<u64> act;
+                for (auto i : SetBitRange(recver.mIntersectionBitmap))
+                    act.push_back(i);
+
+                if (act != exp || recver.mCardinality != exp.size())
+                    throw RTE_LOC;
+            }
+        }
+    }
+}
+
+void Psi_Rs_sharded_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 k = cmd.getOr("k", 3);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    std::vector<coproto::Socket> recvSocks(k), sendSocks(k);
+    for (u64 i = 0; i < k; ++i)
+    {
+        auto s = LocalAsyncSocket::makePair();
+        recvSocks[i] = s[0];
+        sendSocks[i] = s[1];
+    }
+
+    ShardedPsiReceiver recver;
+    ShardedPsiSender sender;
+    recver.init(sendSet.size(), recvSet.size(), k, 40, prng.get(), false);
+    sender.init(sendSet.size(), recvSet.size(), k, 40, prng.get(), false);
+
+    if (recver.mShardRecverSize >= n || recver.mShardRecverSize < n / k)
+        throw RTE_LOC;
+
+    {
+        std::exception_ptr senderError;
+        std::thread senderThrd([&]() {
+            try { sender.run(sendSet, sendSocks); }
+            catch (...) { senderError = std::current_exception(); }
+        });
+
+        recver.run(recvSet, recvSocks);
+        senderThrd.join();
+        if (senderError)
+            std::rethrow_exception(senderError);
+    }
+
+    std::set<u64> act(recver.mIntersection.begin(), recver.mIntersection.end());
+    if (act != exp || act.size() != recver.mIntersection.size())
+        throw RTE_LOC;
+
+    // the sender's shards must run in parallel. The receiver's shard 0
+    // only starts once shard 1 is done, which never happens if the
+    // sender runs its shards one after another.
+    if (k > 1)
+    {
+        for (u64 i = 0; i < k; ++i)
+        {
+            auto s = LocalAsyncSocket::makePair();
+            recvSocks[i] = s[0];
+            sendSocks[i] = s[1];
+        }
+
+        std::exception_ptr senderError;
+        std::thread senderThrd([&]() {
+            try { sender.run(sendSet, sendSocks); }
+            catch (...) { senderError = std::current_exception(); }
+        });
+
+        recver.setInputs(recvSet);
+        std::promise<void> shard1Done;
+        auto shard1DoneFu = shard1Done.get_future();
+        std::atomic<bool> overlapped(true);
+        std::vector<std::exception_ptr> errors(k);
+        std::vector<std::thread> thrds(k);
+        for (u64 i = 0; i < k; ++i)
+        {
+            thrds[i] = std::thread([&, i]() {
+                try {
+                    if (i == 0 && shard1DoneFu.wait_for(std::chrono::seconds(60)) != std::future_status::ready)
+                        overlapped = false;
+                    macoro::sync_wait(recver.runShard(i, recvSocks[i]));
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+                if (i == 1)
+                    shard1Done.set_value();
+            });
+        }
+
+        for (auto& t : thrds)
+            t.join();
+        senderThrd.join();
+
+        if (senderError)
+            std::rethrow_exception(senderError);
+        for (auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+        if (!overlapped)
+            throw RTE_LOC;
+
+        recver.mergeIntersection();
+        std::set<u64> act2(recver.mIntersection.begin(), recver.mIntersection.end());
+        if (act2 != exp)
+            throw RTE_LOC;
+    }
+}
+
+void Psi_Rs_striped_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 numStripes = cmd.getOr("stripes", 2);
+    std::vector<block> recvSet(n), sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < n; ++i)
+    {
+        if (prng.getBit())
+        {
+            recvSet[i] = sendSet[(i + 312) % n];
+            exp.insert(i);
+        }
+    }
+
+    for (auto mal : { false, true })
+    {
+        auto sockets = LocalAsyncSocket::makePair();
+
+        RsPsiReceiver recver;
+        RsPsiSender sender;
+
+        recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, 1);
+        sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, 1);
+        for (u64 i = 0; i < numStripes; ++i)
+        {
+            auto s = LocalAsyncSocket::makePair();
+            recver.mStripes.push_back(s[0]);
+            sender.mStripes.push_back(s[1]);
+        }
+
+        auto p0 = recver.run(recvSet, sockets[0]);
+        auto p1 = sender.run(sendSet, sockets[1]);
+
+        eval(p0, p1);
+
+        std::set<u64> act(recver.mIntersection.begin(), recver.mIntersection.end());
+        if (act != exp)
+            throw RTE_LOC;
+    }
+}
+
+namespace
+{
+    // a receiver of RsPsiServer, the set sizes are exchanged first.
+    Proto serverClient(RsPsiReceiver& recver, std::vector<block>& set, block seed, coproto::Socket& chl)
+    {
+        auto mySize = u64{ set.size() };
+        auto theirSize = u64{};
+        co_await(chl.send(std::move(mySize)));
+        co_await(chl.recv(theirSize));
+
+        recver.init(theirSize, set.size(), 40, seed, false, 1);
+        co_await(recver.run(set, chl));
+    }
+}
+
+void Psi_Rs_server_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 k = cmd.getOr("k", 4);
+    u64 maxSessions = cmd.getOr("maxSessions", 2);
+    std::vector<block> sendSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(sendSet.data(), sendSet.size());
+
+    std::vector<std::vector<block>> recvSets(k);
+    std::vector<std::set<u64>> exp(k);
+    for (u64 j = 0; j < k; ++j)
+    {
+        // receivers of different sizes.
+        recvSets[j].resize(n / (j + 1));
+        prng.get(recvSets[j].data(), recvSets[j].size());
+        for (u64 i = 0; i < recvSets[j].size(); ++i)
+        {
+            if (prng.getBit())
+            {
+                recvSets[j][i] = sendSet[(i * (j + 1) + 312) % n];
+                exp[j].insert(i);
+            }
+        }
+    }
+
+    std::vector<coproto::Socket> recvSocks(k), sendSocks(k);
+    for (u64 i = 0; i < k; ++i)
+    {
+        auto s = LocalAsyncSocket::makePair();
+        recvSocks[i] = s[0];
+        sendSocks[i] = s[1];
+    }
+
+    RsPsiServer server;
+    server.init(sendSet, 40, prng.get(), false, 2, maxSessions);
+    std::vector<RsPsiReceiver> recvers(k);
+
+    // client 0 stalls until the others are done. With fewer workers than
+    // sessions, the others must be served by the remaining workers.
+    auto stall = k > 1 && maxSessions > 1;
+    std::atomic<u64> numDone(0);
+    std::promise<void> othersDone;
+    auto othersDoneFu = othersDone.get_future();
+
+    std::vector<std::thread> clients(k);
+    std::vector<std::exception_ptr> clientErrors(k);
+    for (u64 j = 0; j < k; ++j)
+    {
+        clients[j] = std::thread([&, j]() {
+            try {
+                if (j == 0 && stall)
+                    othersDoneFu.wait();
+                macoro::sync_wait(serverClient(recvers[j], recvSets[j], block(j, 0), recvSocks[j]));
+            }
+            catch (...)
+            {
+                clientErrors[j] = std::current_exception();
+            }
+            if (j && ++numDone == k - 1)
+                othersDone.set_value();
+        });
+    }
+
+    server.run(sendSocks);
+    for (auto& c : clients)
+        c.join();
+
+    for (u64 j = 0; j < k; ++j)
+    {
+        if (server.mSessionErrors[j])
+            std::rethrow_exception(server.mSessionErrors[j]);
+        if (clientErrors[j])
+            std::rethrow_exception(clientErrors[j]);
+
+        std::set<u64> act(recvers[j].mIntersection.begin(), recvers[j].mIntersection.end());
+        if (act != exp[j])
+            throw RTE_LOC;
+    }
+
+    // a receiver larger than mMaxRecverSize is rejected and the other
+    // session still succeeds.
+    if (k > 1)
+    {
+        auto s0 = LocalAsyncSocket::makePair();
+        auto s1 = LocalAsyncSocket::makePair();
+        std::vector<coproto::Socket> chls{ s0[1], s1[1] };
+
+        RsPsiServer server;
+        server.init(sendSet, 40, prng.get(), false, 1, 2);
+        server.mMaxRecverSize = recvSets[1].size();
+
+        // session 0 gets the smaller set, session 1 the full size one.
+        RsPsiReceiver small, large;
+        auto smallFu = std::async(std::launch::async, [&]() {
+            macoro::sync_wait(serverClient(small, recvSets[1], block(0, 1), s0[0]));
+        });
+        auto largeFu = std::async(std::launch::async, [&]() {
+            macoro::sync_wait(serverClient(large, recvSets[0], block(1, 1), s1[0]));
+        });
+
+        server.run(chls);
+        smallFu.get();
+
+        auto rejected = false;
+        try { largeFu.get(); }
+        catch (std::exception&) { rejected = true; }
+
+        if (server.mSessionErrors[0] || !server.mSessionErrors[1] || !rejected)
+            throw RTE_LOC;
+
+        std::set<u64> act(small.mIntersection.begin(), small.mIntersection.end());
+        if (act != exp[1])
+            throw RTE_LOC;
+    }
+}
+
+void Psi_Rs_reuseSolve_test(const CLP& cmd)
+{
+    u64 n = cmd.getOr("n", 13243);
+    u64 k = cmd.getOr("k", 3);
+    std::vector<block> recvSet(n);
+    PRNG prng(ZeroBlock);
+    prng.get(recvSet.data(), recvSet.size());
+
+    for (auto mal : { false, true })
+    {
+        RsPsiReceiver recver;
+        recver.mReuseSolve = true;
+
+        for (u64 j = 0; j < k; ++j)
+        {
+            // senders of different sizes against the same receiver set.
+            std::vector<block> sendSet(n / (j + 1));
+            prng.get(sendSet.data(), sendSet.size());
+
+            std::set<u64> exp;
+            for (u64 i = 0; i < sendSet.size(); ++i)
+            {
+                if (prng.getBit())
+                {
+                    auto r = (i * (j + 1) + 312) % n;
+                    sendSet[i] = recvSet[r];
+                    exp.insert(r);
+                }
+            }
+
+            auto sockets = LocalAsyncSocket::makePair();
+            RsPsiSender sender;
+
+            recver.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, 1);
+            sender.init(sendSet.size(), recvSet.size(), 40, prng.get(), mal, 1);
+
+            auto p0 = recver.run(recvSet, sockets[0]);
+            auto p1 = sender.run(sendSet, sockets[1]);
+
+            eval(p0, p1);
+
+            std::set<u64> act(recver.mIntersection.begin(), recver.mIntersection.end());
+            if (act != exp)
+                throw RTE_LOC;
+        }
+
+        // different values of the same size must not use the cached
+        // solve. The receiver throws before sending anything. The sets
+        // replace a value, duplicate a value and swap two values.
+        std::vector<std::vector<block>> others(3, recvSet);
+        others[0][0] = prng.get();
+        others[1][1] = others[1][0];
+        std::swap(others[2][0], others[2][1]);
+        for (auto& other : others)
+        {
+            auto sockets = LocalAsyncSocket::makePair();
+            recver.init(n, n, 40, prng.get(), mal, 1);
+
+            bool threw = false;
+            try { macoro::sync_wait(recver.run(other, sockets[0])); }
+            catch (std::runtime_error&) { threw = true; }
+            if (!threw)
+                throw RTE_LOC;
+        }
+    }
+}
@@ -15,3 +15,14 @@ void Psi_Rs_full_test(const oc::CLP&);
 void Psi_Rs_reduced_test(const oc::CLP&);
 void Psi_Rs_multiThrd_test(const oc::CLP&);
 void Psi_Rs_mal_test(const oc::CLP&);
+void Psi_Rs_smallMask_test(const oc::CLP&);
+void Psi_Rs_sortMerge_test(const oc::CLP&);
+void Psi_Rs_chunked_test(const oc::CLP&);
+void Psi_Rs_hashCodec_test(const oc::CLP&);
+void Psi_Rs_cardinality_test(const oc::CLP&);
+void Psi_Rs_bitmap_test(const oc::CLP&);
+void Psi_Rs_sharded_test(const oc::CLP&);
+void Psi_Rs_striped_test(const oc::CLP&);
+void Psi_Rs_server_test(const oc::CLP&);
+void Psi_Rs_reuseSolve_test(const oc::CLP&);
+void Psi_SimdHashTable_test(const oc::CLP&);
@@ -0,0 +1,228 @@
+#include "UbPsi_Tests.h"
+#include "volePSI/UbPsi.h"
+#include "cryptoTools/Common/TestCollection.h"
+#include "Common.h"
+#include <set>
+using namespace oc;
+using namespace volePSI;
+using coproto::LocalAsyncSocket;
+
+#ifdef ENABLE_SODIUM
+namespace
+{
+    std::vector<u64> runClient(UbPsiSender& sender, std::vector<block>& clientSet, u64 maxClientSize, PRNG& prng)
+    {
+        auto sockets = LocalAsyncSocket::makePair();
+
+        UbPsiReceiver recver;
+        recver.init(sender.mServerSize, maxClientSize, sender.mSsp, prng.get(), 1);
+
+        auto p0 = recver.receiveTable(sockets[0]);
+        auto p1 = sender.sendTable(sockets[1]);
+        eval(p0, p1);
+
+        auto p2 = recver.run(clientSet, sockets[0]);
+        auto p3 = sender.run(sockets[1]);
+        eval(p2, p3);
+
+        return recver.mIntersection;
+    }
+
+    struct BlockLess
+    {
+        bool operator()(const block& a, const block& b) const
+        {
+            return memcmp(&a, &b, sizeof(block)) < 0;
+        }
+    };
+    using BlockSet = std::set<block, BlockLess>;
+
+    BlockSet intersect(const BlockSet& a, const BlockSet& b)
+    {
+        BlockSet r;
+        for (auto& x : a)
+            if (b.count(x))
+                r.insert(x);
+        return r;
+    }
+}
+#endif
+
+void Psi_Ub_partial_test(const CLP& cmd)
+{
+#ifdef ENABLE_SODIUM
+    u64 ns = cmd.getOr("ns", 1000);
+    u64 nr = cmd.getOr("nr", 100);
+    u64 nt = cmd.getOr("nt", 2);
+    std::vector<block> serverSet(ns), clientSet(nr);
+    PRNG prng(ZeroBlock);
+    prng.get(serverSet.data(), serverSet.size());
+    prng.get(clientSet.data(), clientSet.size());
+
+    std::set<u64> exp;
+    for (u64 i = 0; i < nr; ++i)
+    {
+        if (prng.getBit())
+        {
+            clientSet[i] = serverSet[(i * 7 + 312) % ns];
+            exp.insert(i);
+        }
+    }
+
+    UbPsiSender sender;
+    sender.init(ns, nr, 40, prng.get(), nt);
+    sender.preprocess(serverSet);
+
+    auto inter = runClient(sender, clientSet, nr, prng);
+    std::set<u64> act(inter.begin(), inter.end());
+    if (act != exp)
+        throw RTE_LOC;
+#else
+    throw UnitTestSkipped("ENABLE_SODIUM not defined.");
+#endif
+}
+
+void Psi_Ub_multiClient_test(const CLP& cmd)
+{
+#ifdef ENABLE_SODIUM
+    u64 ns = cmd.getOr("ns", 1000);
+    u64 nr = cmd.getOr("nr", 50);
+    u64 numClients = cmd.getOr("nc", 3);
+    std::vector<block> serverSet(ns);
+    PRNG prng(ZeroBlock);
+    prng.get(serverSet.data(), serverSet.size());
+
+    // the server preprocesses its set once and serves every client with it.
+    UbPsiSender sender;
+    sender.init(ns, nr, 40, prng.get(), 1);
+    sender.preprocess(serverSet);
+
+    for (u64 c = 0; c < numClients; ++c)
+    {
+        std::vector<block> clientSet(nr);
+        prng.get(clientSet.data(), clientSet.size());
+
+        std::set<u64> exp;
+        for (u64 i = c; i < nr; i += numClients)
+        {
+            clientSet[i] = serverSet[(i + c * nr) % ns];
+            exp.insert(i);
+        }
+
+        auto inter = runClient(sender, clientSet, nr, prng);
+        std::set<u64> act(inter.begin(), inter.end());
+        if (act != exp)
+            throw RTE_LOC;
+    }
+#else
+    throw UnitTestSkipped("ENABLE_SODIUM not defined.");
+#endif
+}
+
+void Psi_Ub_delta_test(const CLP& cmd)
+{
+#ifdef ENABLE_SODIUM
+    u64 ns = cmd.getOr("ns", 1000);
+    u64 nr = cmd.getOr("nr", 100);
+    u64 days = cmd.getOr("days", 3);
+    u64 d = cmd.getOr("d", 10);
+    PRNG prng(ZeroBlock);
+
+    std::vector<block> serverSet(ns), clientSet(nr);
+    prng.get(serverSet.data(), serverSet.size());
+    prng.get(clientSet.data(), clientSet.size());
+    for (u64 i = 0; i < nr; i += 2)
+        clientSet[i] = serverSet[(i * 7 + 312) % ns];
+
+    UbPsiSender sender;
+    UbPsiReceiver recver;
+    sender.init(ns, nr + days * d, 40, prng.get(), 2);
+    recver.init(ns, nr + days * d, 40, prng.get(), 2);
+    sender.preprocess(serverSet);
+
+    auto sockets = LocalAsyncSocket::makePair();
+    {
+        auto p0 = recver.receiveTable(sockets[0]);
+        auto p1 = sender.sendTable(sockets[1]);
+        eval(p0, p1);
+    }
+
+    BlockSet server(serverSet.begin(), serverSet.end());
+    BlockSet client;
+    auto prev = BlockSet{};
+    std::vector<block> clientAdded = clientSet, clientRemoved;
+
+    for (u64 day = 0; day <= days; ++day)
+    {
+        recver.clearDelta();
+
+        if (day)
+        {
+            // the server removes some items that the client has and adds
+            // some that it has and the server does not.
+            std::vector<block> serverAdded, serverRemoved;
+            for (auto& x : client)
+            {
+                if (server.count(x) && serverRemoved.size() < d / 2)
+                    serverRemoved.push_back(x);
+                else if (!server.count(x) && serverAdded.size() < d / 2)
+                    serverAdded.push_back(x);
+            }
+            while (serverAdded.size() < d)
+                serverAdded.push_back(prng.get());
+            for (auto& x : serverRemoved)
+                server.erase(x);
+            for (auto& x : serverAdded)
+                server.insert(x);
+
+            sender.update(serverAdded, serverRemoved);
+            auto p0 = recver.receiveUpdate(sockets[0]);
+            auto p1 = sender.sendUpdate(sockets[1]);
+            eval(p0, p1);
+
+            clientAdded.clear();
+            for (u64 i = 0; clientAdded.size() < d / 2; ++i)
+            {
+                auto& x = serverSet[(day * 31 + i * 11) % ns];
+                if (!client.count(x))
+                    clientAdded.push_back(x);
+            }
+            while (clientAdded.size() < d)
+                clientAdded.push_back(prng.get());
+            clientRemoved.clear();
+            for (auto& x : client)
+                if (clientRemoved.size() < d / 2 && prng.getBit())
+                    clientRemoved.push_back(x);
+        }
+
+        for (auto& x : clientRemoved)
+            client.erase(x);
+        for (auto& x : clientAdded)
+            client.insert(x);
+
+        auto p0 = recver.runDelta(clientAdded, clientRemoved, sockets[0]);
+        auto p1 = sender.run(sockets[1]);
+        eval(p0, p1);
+
+        auto exp = intersect(client, server);
+        BlockSet act;
+        for (auto& item : recver.mItems)
+            if (item.mInIntersection)
+                act.insert(item.mItem);
+        if (act != exp || recver.mItems.size() != client.size())
+            throw RTE_LOC;
+
+        // the reported changes take prev to exp.
+        auto next = prev;
+        for (auto& x : recver.mIntersectionRemoved)
+            next.erase(x);
+        for (auto& x : recver.mIntersectionAdded)
+            next.insert(x);
+        if (next != exp)
+            throw RTE_LOC;
+        prev = exp;
+    }
+#else
+    throw UnitTestSkipped("ENABLE_SODIUM not defined.");
+#endif
+}
@@ -8,6 +8,7 @@
 #include "RsOprf_Tests.h"
 #include "RsOpprf_Tests.h"
 #include "RsPsi_Tests.h"
+#include "UbPsi_Tests.h"
 #include "RsCpsi_Tests.h"
 #include "GMW_Tests.h"
 #include "volePSI/GMW/Circuit.h"
@@ -40,6 +41,7 @@ namespace volePSI_Tests
         t.add("generateBase_test           ", generateBase_test);
 
         t.add("isZeroCircuit_Test          ", isZeroCircuit_Test);
+        t.add("cpsiAggregateCircuit_Test   ", cpsiAggregateCircuit_Test);
         t.add("Gmw_half_test               ", Gmw_half_test);
         t.add("Gmw_basic_test              ", Gmw_basic_test);
         t.add("Gmw_inOut_test              ", Gmw_inOut_test);
@@ -63,6 +65,8 @@ namespace volePSI_Tests
 
         t.add("RsOpprf_eval_blk_mtx_test   ", RsOpprf_eval_blk_mtx_test);
         t.add("RsOpprf_eval_u8_mtx_test    ", RsOpprf_eval_u8_mtx_test);
+        t.add("RsOpprf_eval_mt_test        ", RsOpprf_eval_mt_test);
+        t.add("Psi_RsLabeled_test          ", Psi_RsLabeled_test);
 #endif
 
         t.add("Psi_Rs_empty_test           ", Psi_Rs_empty_test);
@@ -71,13 +75,34 @@ namespace volePSI_Tests
         t.add("Psi_Rs_reduced_test         ", Psi_Rs_reduced_test);
         t.add("Psi_Rs_multiThrd_test       ", Psi_Rs_multiThrd_test);
         t.add("Psi_Rs_mal_test             ", Psi_Rs_mal_test);
+        t.add("Psi_Rs_smallMask_test       ", Psi_Rs_smallMask_test);
+        t.add("Psi_Rs_sortMerge_test       ", Psi_Rs_sortMerge_test);
+        t.add("Psi_Rs_chunked_test         ", Psi_Rs_chunked_test);
+        t.add("Psi_Rs_hashCodec_test       ", Psi_Rs_hashCodec_test);
+        t.add("Psi_Rs_cardinality_test     ", Psi_Rs_cardinality_test);
+        t.add("Psi_Rs_bitmap_test          ", Psi_Rs_bitmap_test);
+        t.add("Psi_Rs_sharded_test         ", Psi_Rs_sharded_test);
+        t.add("Psi_Rs_striped_test         ", Psi_Rs_striped_test);
+        t.add("Psi_Rs_server_test          ", Psi_Rs_server_test);
+        t.add("Psi_Rs_reuseSolve_test      ", Psi_Rs_reuseSolve_test);
+        t.add("Psi_SimdHashTable_test      ", Psi_SimdHashTable_test);
+
+        t.add("Psi_Ub_partial_test         ", Psi_Ub_partial_test);
+        t.add("Psi_Ub_multiClient_test     ", Psi_Ub_multiClient_test);
+        t.add("Psi_Ub_delta_test           ", Psi_Ub_delta_test);
                                            
 #ifdef VOLE_PSI_ENABLE_CPSI
         t.add("Cpsi_Rs_empty_test          ", Cpsi_Rs_empty_test);
         t.add("Cpsi_Rs_partial_test        ", Cpsi_Rs_partial_test);
+        t.add("Cpsi_Rs_partial_mt_test     ", Cpsi_Rs_partial_mt_test);
         t.add("Cpsi_Rs_full_test           ", Cpsi_Rs_full_test);
         t.add("Cpsi_Rs_full_asym_test      ", Cpsi_Rs_full_asym_test);
         t.add("Cpsi_Rs_full_add32_test     ", Cpsi_Rs_full_add32_test);
+        t.add("Cpsi_Rs_full_add64_test     ", Cpsi_Rs_full_add64_test);
+        t.add("Cpsi_Rs_full_modp_test      ", Cpsi_Rs_full_modp_test);
+        t.add("Cpsi_Rs_aggregate_test      ", Cpsi_Rs_aggregate_test);
+        t.add("Cpsi_Rs_compact_test        ", Cpsi_Rs_compact_test);
+        t.add("Cpsi_Rs_chunked_test        ", Cpsi_Rs_chunked_test);
 #endif
 
         t.add("filebase_readSet_Test       ", filebase_readSet_Test);
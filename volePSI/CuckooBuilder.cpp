@@ -0,0 +1,97 @@
+#include "CuckooBuilder.h"
+#include "cryptoTools/Common/CuckooIndex.h"
+#include "cryptoTools/Common/Matrix.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace volePSI
+{
+    void CuckooBuilder::init(u64 numItems, u64 statSecParam, u64 numHashFunctions)
+    {
+        auto params = oc::CuckooIndex<>::selectParams(numItems, statSecParam, 0, numHashFunctions);
+        mNumBins = params.numBins();
+        mNumHashFunctions = numHashFunctions;
+        mBins.assign(mNumBins, sEmpty);
+    }
+
+    void CuckooBuilder::insert(span<const block> items, block hashingSeed, u64 numThreads)
+    {
+        if (items.size() >= (1ull << 56))
+            throw RTE_LOC;
+
+        // the same locations as oc::CuckooIndex<>, see SimpleIndex::insertItems.
+        oc::CuckooIndex<> cuckoo;
+        cuckoo.mMods.resize(mNumHashFunctions);
+        for (u64 i = 0; i < cuckoo.mMods.size(); ++i)
+            cuckoo.mMods[i] = oc::Mod(mNumBins - i);
+
+        oc::Matrix<u32> locations(items.size(), mNumHashFunctions, oc::AllocType::Uninitialized);
+        std::atomic<bool> failed(false);
+
+        numThreads = std::max<u64>(1, std::min<u64>(numThreads, oc::divCeil(items.size(), 1 << 12)));
+        auto numBatches = oc::divCeil(items.size(), 32);
+        auto rangeBegin = [&](u64 t) { return std::min<u64>(items.size(), t * numBatches / numThreads * 32); };
+
+        auto hashRoutine = [&](u64 begin, u64 end)
+        {
+            oc::Matrix<u32> loc(32, mNumHashFunctions);
+            std::array<block, 32> hashs;
+            oc::AES hasher(hashingSeed);
+            for (u64 i = begin; i < end; i += hashs.size())
+            {
+                auto min = std::min<u64>(end - i, hashs.size());
+                hasher.hashBlocks(items.data() + i, min, hashs.data());
+                cuckoo.computeLocations(hashs, loc);
+                std::memcpy(locations[i].data(), loc.data(), min * mNumHashFunctions * sizeof(u32));
+            }
+        };
+
+        auto insertRoutine = [&](u64 begin, u64 end)
+        {
+            for (u64 i = begin; i < end && !failed.load(std::memory_order_relaxed); ++i)
+            {
+                u64 cur = i;
+                u64 h = 0;
+                u64 iter = 0;
+                while (true)
+                {
+                    auto bin = locations(cur, h);
+                    auto prev = std::atomic_ref<u64>(mBins[bin]).exchange(
+                        cur | (h << 56), std::memory_order_relaxed);
+
+                    if (prev == sEmpty)
+                        break;
+
+                    if (++iter == sMaxIters)
+                    {
+                        failed = true;
+                        return;
+                    }
+
+                    // continue with the evicted item under its next hash function.
+                    cur = prev & (~0ull >> 8);
+                    h = ((prev >> 56) + 1) % mNumHashFunctions;
+                }
+            }
+        };
+
+        auto run = [&](auto& routine)
+        {
+            std::vector<std::thread> thrds(numThreads - 1);
+            for (u64 t = 1; t < numThreads; ++t)
+                thrds[t - 1] = std::thread(routine, rangeBegin(t), rangeBegin(t + 1));
+
+            routine(rangeBegin(0), rangeBegin(1));
+
+            for (auto& t : thrds)
+                t.join();
+        };
+
+        run(hashRoutine);
+        run(insertRoutine);
+
+        if (failed)
+            throw std::runtime_error("CuckooBuilder: cuckoo hashing failed. " LOCATION);
+    }
+}
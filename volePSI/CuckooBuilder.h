@@ -0,0 +1,48 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include <vector>
+
+namespace volePSI
+{
+    // A cuckoo hash table that is built by several threads at once, with
+    // the same bins and hash functions as oc::CuckooIndex<>. Each bin is
+    // one word that holds the index of an item and the hash function it
+    // uses. A thread places an item by atomically swapping it into its
+    // bin and then continues with the item that it evicted, if any, under
+    // that item's next hash function. No item is lost by a swap, so the
+    // threads need no locks.
+    class CuckooBuilder
+    {
+    public:
+        static constexpr u64 sEmpty = ~0ull;
+
+        // the number of evictions after which an insert fails.
+        static constexpr u64 sMaxIters = 500;
+
+        u64 mNumBins = 0;
+        u64 mNumHashFunctions = 0;
+        std::vector<u64> mBins;
+
+        // numBins is that of oc::CuckooIndex<>::selectParams(numItems, ssp, 0, numHashFunctions).
+        void init(u64 numItems, u64 statSecParam, u64 numHashFunctions = 3);
+
+        // Insert the items. Throws if cuckoo hashing fails.
+        void insert(span<const block> items, block hashingSeed, u64 numThreads);
+
+        bool isEmpty(u64 bin) const { return mBins[bin] == sEmpty; }
+
+        // The index of the item in the bin.
+        u64 idx(u64 bin) const { return mBins[bin] & (~0ull >> 8); }
+
+        // The hash function that places the item in the bin.
+        u64 hashIdx(u64 bin) const { return mBins[bin] >> 56; }
+    };
+}
@@ -2,6 +2,79 @@
 #include <string>
 namespace volePSI
 {
+    namespace
+    {
+        // the n wires of b starting at offset.
+        BetaBundle slice(BetaBundle& b, u64 offset, u64 n)
+        {
+            BetaBundle r;
+            r.mWires.assign(b.mWires.begin() + offset, b.mWires.begin() + offset + n);
+            return r;
+        }
+
+        // out = a + b mod 2^n as a ripple carry adder with n - 1 AND
+        // gates, where the carry is c' = ((a ^ c) & (b ^ c)) ^ c.
+        void addAdder(BetaCircuit& cd, BetaBundle& a, BetaBundle& b, BetaBundle& out)
+        {
+            auto n = out.size();
+            cd.addGate(a[0], b[0], oc::GateType::Xor, out[0]);
+            if (n == 1)
+                return;
+
+            BetaBundle c(n - 1), t(3 * (n - 1));
+            cd.addTempWireBundle(c);
+            cd.addTempWireBundle(t);
+
+            cd.addGate(a[0], b[0], oc::GateType::And, c[0]);
+            for (u64 i = 1; i < n; ++i)
+            {
+                auto t0 = t[3 * i - 3], t1 = t[3 * i - 2], t2 = t[3 * i - 1];
+                cd.addGate(a[i], c[i - 1], oc::GateType::Xor, t0);
+                cd.addGate(t0, b[i], oc::GateType::Xor, out[i]);
+
+                if (i + 1 < n)
+                {
+                    cd.addGate(b[i], c[i - 1], oc::GateType::Xor, t1);
+                    cd.addGate(t0, t1, oc::GateType::And, t2);
+                    cd.addGate(t2, c[i - 1], oc::GateType::Xor, c[i]);
+                }
+            }
+        }
+
+        // out = a + e mod 2^n for the wire e.
+        void addBit(BetaCircuit& cd, BetaBundle& a, u64 e, BetaBundle& out)
+        {
+            auto n = out.size();
+            BetaBundle c(n - 1);
+            if (n > 1)
+                cd.addTempWireBundle(c);
+
+            auto carry = e;
+            for (u64 i = 0; i < n; ++i)
+            {
+                cd.addGate(a[i], carry, oc::GateType::Xor, out[i]);
+                if (i + 1 < n)
+                {
+                    cd.addGate(a[i], carry, oc::GateType::And, c[i]);
+                    carry = c[i];
+                }
+            }
+        }
+
+        // a wire which is one if all the wires of a are zero. The
+        // wires of a are overwritten, see isZeroCircuit.
+        auto addIsZero(BetaCircuit& cd, BetaBundle& a)
+        {
+            for (u64 i = 0; i < a.size(); ++i)
+                cd.addInvert(a[i]);
+
+            for (u64 step = 1; step < a.size(); step *= 2)
+                for (u64 i = 0; i + step < a.size(); i += step * 2)
+                    cd.addGate(a[i], a[i + step], oc::GateType::And, a[i]);
+
+            return a[0];
+        }
+    }
 
     BetaCircuit isZeroCircuit(u64 bits)
     {
@@ -78,4 +151,126 @@ namespace volePSI
 
 
     }
+
+    BetaCircuit cpsiAggregateCircuit(u64 keyBits, u64 numCategories)
+    {
+        BetaCircuit cd;
+
+        auto numWords = numCategories ? 2 : 1;
+        auto numOut = 2 + 2 * numCategories;
+        BetaBundle key(keyBits), s(32 * numWords), t(32 * numWords), m(32 * numOut), out(32 * numOut);
+
+        cd.addInputBundle(key);
+        cd.addInputBundle(s);
+        cd.addInputBundle(t);
+        cd.addInputBundle(m);
+        cd.addOutputBundle(out);
+
+        // the value is the sum of the two shares.
+        BetaBundle v(32), z(32 * (1 + numCategories)), e(numCategories + 1), zero(1);
+        cd.addTempWireBundle(v);
+        cd.addTempWireBundle(z);
+        cd.addTempWireBundle(e);
+        cd.addTempWireBundle(zero);
+
+        auto s0 = slice(s, 0, 32);
+        auto t0 = slice(t, 0, 32);
+        addAdder(cd, s0, t0, v);
+        cd.addGate(s[0], s[0], oc::GateType::Xor, zero[0]);
+
+        // e[0] is the intersection flag and e[1 + g] is set if the
+        // flag is set and the category is g.
+        auto flag = addIsZero(cd, key);
+        cd.addGate(flag, zero[0], oc::GateType::Xor, e[0]);
+
+        if (numCategories)
+        {
+            // only the low bits of the category are needed to tell the
+            // categories apart, and so is the sum of the shares.
+            auto catBits = std::max<u64>(1, oc::log2ceil(numCategories));
+            BetaBundle cat(catBits);
+            cd.addTempWireBundle(cat);
+            auto s1 = slice(s, 32, catBits);
+            auto t1 = slice(t, 32, catBits);
+            addAdder(cd, s1, t1, cat);
+
+            for (u64 g = 0; g < numCategories; ++g)
+            {
+                BetaBundle eq(catBits);
+                cd.addTempWireBundle(eq);
+                for (u64 b = 0; b < catBits; ++b)
+                    cd.addGate(cat[b], zero[0], (g >> b) & 1 ? oc::GateType::Nxor : oc::GateType::Xor, eq[b]);
+
+                // eq is zero iff the category is g.
+                cd.addGate(flag, addIsZero(cd, eq), oc::GateType::And, e[1 + g]);
+            }
+        }
+
+        for (u64 j = 0; j < e.size(); ++j)
+        {
+            auto mc = slice(m, 64 * j, 32);
+            auto ms = slice(m, 64 * j + 32, 32);
+            auto outC = slice(out, 64 * j, 32);
+            auto outS = slice(out, 64 * j + 32, 32);
+            auto zj = slice(z, 32 * j, 32);
+
+            addBit(cd, mc, e[j], outC);
+
+            for (u64 b = 0; b < 32; ++b)
+                cd.addGate(e[j], v[b], oc::GateType::And, zj[b]);
+            addAdder(cd, zj, ms, outS);
+        }
+
+        cd.levelByAndDepth();
+
+        return cd;
+    }
+
+    void cpsiAggregateCircuit_Test()
+    {
+        u64 keyBits = 20, tt = 100;
+        oc::PRNG prng(oc::ZeroBlock);
+
+        for (u64 numCategories : { 0, 1, 3 })
+        {
+            auto cir = cpsiAggregateCircuit(keyBits, numCategories);
+            u64 numWords = numCategories ? 2 : 1;
+            u64 numOut = 2 + 2 * numCategories;
+
+            for (u64 i = 0; i < tt; ++i)
+            {
+                std::vector<u32> s(numWords), t(numWords), v(numWords), m(numOut), out(numOut);
+                prng.get(s.data(), s.size());
+                prng.get(m.data(), m.size());
+
+                bool flag = prng.getBit();
+                v[0] = prng.get<u32>();
+                if (numCategories)
+                    v[1] = prng.get<u32>() % numCategories;
+                for (u64 j = 0; j < numWords; ++j)
+                    t[j] = v[j] - s[j];
+
+                std::vector<oc::BitVector> in(4);
+                in[0].resize(keyBits);
+                if (!flag)
+                    in[0].randomize(prng);
+                flag = in[0].hammingWeight() == 0;
+                in[1].append((u8*)s.data(), 32 * numWords);
+                in[2].append((u8*)t.data(), 32 * numWords);
+                in[3].append((u8*)m.data(), 32 * numOut);
+                oc::BitVector o(32 * numOut);
+
+                cir.evaluate(in, { &o, 1 }, false);
+                std::memcpy(out.data(), o.data(), out.size() * sizeof(u32));
+
+                for (u64 j = 0; j < numOut / 2; ++j)
+                {
+                    bool e = flag && (j == 0 || v[1] == j - 1);
+                    if (out[2 * j] != u32(m[2 * j] + e) ||
+                        out[2 * j + 1] != u32(m[2 * j + 1] + (e ? v[0] : 0)))
+                        throw RTE_LOC;
+                }
+            }
+        }
+    }
 }
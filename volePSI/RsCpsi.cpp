@@ -1,9 +1,210 @@
 #include "RsCpsi.h"
+#include "libdivide.h"
 
+#include <cmath>
 #include <sstream>
+#include <thread>
 
 namespace volePSI
 {
+    namespace
+    {
+        // Hashes blocks under one of the three cuckoo hash keys. The blocks
+        // are hashed in batches of 32 per key with hashBlocks and the result
+        // of push(j, x, i) is written to dest[i].
+        struct BatchHasher
+        {
+            struct Batch
+            {
+                std::array<block, 32> mIn, mOut;
+                std::array<u64, 32> mDest;
+                u64 mSize = 0;
+            };
+
+            const std::array<oc::AES, 3>& mHashers;
+            span<block> mDest;
+            std::array<Batch, 3> mBatches;
+
+            BatchHasher(const std::array<oc::AES, 3>& hashers, span<block> dest)
+                : mHashers(hashers)
+                , mDest(dest)
+            {}
+
+            ~BatchHasher() { flush(); }
+
+            void push(u64 j, const block& x, u64 dest)
+            {
+                auto& bt = mBatches[j];
+                bt.mIn[bt.mSize] = x;
+                bt.mDest[bt.mSize] = dest;
+                if (++bt.mSize == bt.mIn.size())
+                    flush(j);
+            }
+
+            void flush(u64 j)
+            {
+                auto& bt = mBatches[j];
+                mHashers[j].hashBlocks(bt.mIn.data(), bt.mSize, bt.mOut.data());
+                for (u64 q = 0; q < bt.mSize; ++q)
+                    mDest[bt.mDest[q]] = bt.mOut[q];
+                bt.mSize = 0;
+            }
+
+            void flush()
+            {
+                for (u64 j = 0; j < mBatches.size(); ++j)
+                    flush(j);
+            }
+        };
+
+        // calls fn(begin, end) for numThreads disjoint sub-ranges of [0, n).
+        template<typename Fn>
+        void parallelFor(u64 n, u64 numThreads, Fn&& fn)
+        {
+            numThreads = std::max<u64>(1, std::min<u64>(numThreads, oc::divCeil(n, 1 << 12)));
+            std::vector<std::thread> thrds(numThreads - 1);
+            for (u64 t = 1; t < numThreads; ++t)
+                thrds[t - 1] = std::thread([&, t]() {
+                    fn(t * n / numThreads, (t + 1) * n / numThreads);
+                });
+
+            fn(0, n / numThreads);
+
+            for (auto& t : thrds)
+                t.join();
+        }
+
+        // true if values of byteLength bytes can be shared as type.
+        bool validShareType(ValueShareType type, u64 byteLength, u64 modulus)
+        {
+            switch (type)
+            {
+            case ValueShareType::Xor: return true;
+            case ValueShareType::add32: return byteLength % sizeof(u32) == 0;
+            case ValueShareType::add64: return byteLength % sizeof(u64) == 0;
+            case ValueShareType::modP: return byteLength % sizeof(u64) == 0 && modulus > 1;
+            default: return false;
+            }
+        }
+
+        // fills dest with uniform values mod p. Each is reduced from 128
+        // random bits x as floor(x * p / 2^128), which is within 2^-64 of
+        // uniform, without a division.
+        void sampleModP(PRNG& prng, span<u64> dest, u64 p)
+        {
+            std::array<block, 128> x;
+            for (u64 i = 0; i < dest.size(); i += x.size())
+            {
+                auto n = std::min<u64>(x.size(), dest.size() - i);
+                prng.get(x.data(), n);
+                for (u64 j = 0; j < n; ++j)
+                {
+                    auto lo = x[j].get<u64>(0);
+                    auto hi = x[j].get<u64>(1);
+                    auto hpLo = hi * p;
+                    auto sum = hpLo + libdivide::libdivide_mullhi_u64(lo, p);
+                    dest[i + j] = libdivide::libdivide_mullhi_u64(hi, p) + (sum < hpLo);
+                }
+            }
+        }
+
+        // v -= s word by word for the additive share types.
+        template<typename T>
+        void subWords(u8* v, const u8* s, u64 byteLength)
+        {
+            auto v0 = (T*)v;
+            auto s0 = (const T*)s;
+            for (u64 k = 0; k < byteLength / sizeof(T); ++k)
+                v0[k] -= s0[k];
+        }
+
+        // v = v - s mod p for each u64 word, where v, s < p.
+        void subWordsModP(u8* v, const u8* s, u64 byteLength, u64 p)
+        {
+            auto v0 = (u64*)v;
+            auto s0 = (const u64*)s;
+            for (u64 k = 0; k < byteLength / sizeof(u64); ++k)
+                v0[k] = v0[k] - s0[k] + (v0[k] < s0[k] ? p : 0);
+        }
+
+        // the number of OPPRF inputs of the sender for the bins [begin, end).
+        // With one chunk this is all 3n of them. Otherwise it is a bound on
+        // the load of the chunk, exceeded with probability about 2^-ssp.
+        u64 chunkPoints(u64 senderSize, u64 numBins, u64 begin, u64 end, u64 ssp)
+        {
+            auto total = senderSize * 3;
+            if (begin == 0 && end == numBins)
+                return total;
+
+            // Chernoff, Pr[X >= mu + t] <= exp(-t^2 / (2 (mu + t/3))).
+            auto mu = double(total) * (end - begin) / numBins;
+            auto s = (ssp + oc::log2ceil(oc::divCeil(numBins, end - begin))) * std::log(2.0);
+            auto bound = u64(std::ceil(mu + std::sqrt(2 * mu * s) + 2 * s / 3));
+            return std::min(total, bound);
+        }
+
+        // moves the output of the chunk starting at bin begin into ret, or
+        // hands it to the callback if there is one. The aggregates are
+        // always summed into ret.
+        template<typename Sharing, typename Callback>
+        void deliverChunk(Sharing& chunk, u64 begin, u64 numBins, Sharing& ret, Callback& callback)
+        {
+            for (u64 k = 0; k < chunk.mAggregates.size(); ++k)
+                ret.mAggregates[k] += chunk.mAggregates[k];
+
+            if (callback)
+            {
+                callback(begin, chunk);
+                return;
+            }
+
+            if (begin == 0 && chunk.mValues.rows() == numBins)
+            {
+                ret.mFlagBits = std::move(chunk.mFlagBits);
+                ret.mValues = std::move(chunk.mValues);
+                return;
+            }
+
+            if (begin == 0)
+            {
+                ret.mFlagBits.resize(0);
+                ret.mFlagBits.resize(chunk.mFlagBits.size() ? numBins : 0);
+                ret.mValues.resize(numBins, chunk.mValues.cols(), oc::AllocType::Uninitialized);
+            }
+
+            for (u64 i = 0; i < chunk.mFlagBits.size(); ++i)
+                ret.mFlagBits[begin + i] = chunk.mFlagBits[i];
+            if (chunk.mValues.size())
+                std::memcpy(&ret.mValues(begin, 0), chunk.mValues.data(), chunk.mValues.size());
+        }
+
+        // the per bin values followed by the receiver's input index.
+        Matrix<u8> compactTable(oc::MatrixView<u8> values, span<const u32> idx)
+        {
+            Matrix<u8> ret(idx.size(), values.cols() + sizeof(u32), oc::AllocType::Uninitialized);
+            for (u64 i = 0; i < idx.size(); ++i)
+            {
+                if (values.cols())
+                    std::memcpy(ret[i].data(), values[i].data(), values.cols());
+                std::memcpy(&ret(i, values.cols()), &idx[i], sizeof(u32));
+            }
+            return ret;
+        }
+
+        // the inverse of compactTable.
+        void splitTable(const Matrix<u8>& table, Matrix<u8>& values, std::vector<u32>& idx)
+        {
+            auto cols = table.cols() - sizeof(u32);
+            values.resize(table.rows(), cols, oc::AllocType::Uninitialized);
+            idx.resize(table.rows());
+            for (u64 i = 0; i < table.rows(); ++i)
+            {
+                if (cols)
+                    std::memcpy(values[i].data(), table[i].data(), cols);
+                std::memcpy(&idx[i], &table(i, cols), sizeof(u32));
+            }
+        }
+    }
 
     Proto RsCpsiSender::send(span<block> Y, oc::MatrixView<u8> values, Sharing& ret, Socket& chl)
     {
@@ -14,15 +215,26 @@ namespace volePSI
             auto keyBitLength = u64{};
             auto keyByteLength = u64{};
             auto hashers = std::array<oc::AES, 3> {};
+            auto chunkSize = u64{};
+            auto chunkBegin = u64{};
+            auto chunkEnd = u64{};
+            auto chunkBins = u64{};
+            auto numPoints = u64{};
+            auto chunk = Sharing{};
             auto Ty = std::vector<block>{};
             auto Tv = Matrix<u8>{};
             auto r = Matrix<u8>{};
-            auto TyIter = std::vector<block>::iterator{};
-            auto TvIter = Matrix<u8>::iterator{};
-            auto rIter = Matrix<u8>::iterator{};
-            auto opprf = std::make_unique<RsOpprfSender>();
-            auto cmp = std::make_unique<Gmw>();
+            auto binBegin = std::vector<u64>{};
+            auto opprf = std::unique_ptr<RsOpprfSender>{};
+            auto cmp = std::unique_ptr<Gmw>{};
             auto cir = BetaCircuit{};
+            auto fork = Socket{};
+            auto triples = macoro::eager_task<void>{};
+            auto aggIn = Matrix<u32>{};
+            auto masks = Matrix<u32>{};
+            auto aggOut = Matrix<u32>{};
+            auto compactor = Compactor{};
+            auto table = Matrix<u8>{};
 
         setTimePoint("RsCpsiSender::send begin");
         if (mSenderSize != Y.size() || mValueByteLength != values.cols())
@@ -31,145 +243,267 @@ namespace volePSI
             throw RTE_LOC;
         }
 
+        if (values.size() && !validShareType(mType, values.cols(), mModulus))
+        {
+            co_await chl.close();
+            throw RTE_LOC;
+        }
+
+        if (mAggregate && (mType != ValueShareType::add32 ||
+            values.cols() < sizeof(u32) * (mNumCategories ? 2 : 1)))
+        {
+            co_await chl.close();
+            throw RTE_LOC;
+        }
+
+        if (mCompactBound && (mType != ValueShareType::Xor || mAggregate || mChunkCallback))
+        {
+            co_await chl.close();
+            throw RTE_LOC;
+        }
+
         co_await (chl.recv(cuckooSeed));
         setTimePoint("RsCpsiSender::send recv");
 
         params = oc::CuckooIndex<>::selectParams(mRecverSize, mSsp, 0, 3);
         numBins = params.numBins();
-        sIdx.init(numBins, mSenderSize, mSsp, 3);
-        sIdx.insertItems(Y, cuckooSeed);
-
-        setTimePoint("RsCpsiSender::send simpleHash");
-
-
         keyBitLength = mSsp + oc::log2ceil(params.numBins());
         keyByteLength = oc::divCeil(keyBitLength, 8);
 
+        cir = mAggregate ?
+            cpsiAggregateCircuit(keyBitLength, mNumCategories) :
+            isZeroCircuit(keyBitLength);
+
+        sIdx.init(numBins, mSenderSize, mSsp, 3);
+
         hashers[0].setKey(block(3242, 23423) ^ cuckooSeed);
         hashers[1].setKey(block(4534, 45654) ^ cuckooSeed);
         hashers[2].setKey(block(5677, 67867) ^ cuckooSeed);
 
-        // The OPPRF input value of the i'th input under the j'th cuckoo
-        // hash function.
-        Ty.resize(Y.size() * 3);
-
-        // The value associated with the k'th OPPRF input
-        Tv.resize(Y.size() * 3, keyByteLength + values.cols(), oc::AllocType::Uninitialized);
+        // The bins are processed in chunks, each with its own OPPRF and
+        // GMW, see RsCpsiBase::mChunkSize. By default there is one chunk.
+        chunkSize = mChunkSize ? std::min(mChunkSize, numBins) : numBins;
+        ret.mAggregates.assign(mAggregate ? numAggregates() : 0, 0);
 
-        // The special value assigned to the i'th bin.
-        r.resize(numBins, keyByteLength, oc::AllocType::Uninitialized);
-
-        TyIter = Ty.begin();
-        TvIter = Tv.begin();
-        rIter = r.begin();
-        ret.mValues.resize(numBins, values.cols(), oc::AllocType::Uninitialized);
-        mPrng.get<u8>(r);
-        mPrng.get<u8>(ret.mValues);
+        for (chunkBegin = 0; chunkBegin < numBins; chunkBegin = chunkEnd)
+        {
+            chunkEnd = std::min(numBins, chunkBegin + chunkSize);
+            chunkBins = chunkEnd - chunkBegin;
+            numPoints = chunkPoints(mSenderSize, numBins, chunkBegin, chunkEnd, mSsp);
+
+            // The GMW triples only depend on chunkBins and keyBitLength. They
+            // are generated on a fork while the OPPRF is running.
+            cmp = std::make_unique<Gmw>();
+            if (mTimer)
+                cmp->setTimer(*mTimer);
+            cmp->init(chunkBins, cir, mNumThreads, 1, mPrng.get());
+            fork = chl.fork();
+            triples = cmp->generateTriple(1 << 20, 2, fork) | macoro::make_eager();
+
+            sIdx.setBinRange(chunkBegin, chunkEnd);
+            sIdx.insertItems(Y, cuckooSeed, mNumThreads);
+
+            setTimePoint("RsCpsiSender::send simpleHash");
+
+            // the first OPPRF input of the i'th bin of the chunk.
+            binBegin.resize(chunkBins + 1);
+            binBegin[0] = 0;
+            for (u64 i = 0; i < chunkBins; ++i)
+                binBegin[i + 1] = binBegin[i] + sIdx.mBinSizes[i];
+
+            if (binBegin.back() > numPoints)
+            {
+                co_await chl.close();
+                throw std::runtime_error("RsCpsi: chunk overflow. " LOCATION);
+            }
 
+            // The OPPRF input value of the i'th input under the j'th cuckoo
+            // hash function.
+            Ty.resize(numPoints);
 
+            // The value associated with the k'th OPPRF input
+            Tv.resize(numPoints, keyByteLength + values.cols(), oc::AllocType::Uninitialized);
 
-        for (u64 i = 0; i < numBins; ++i)
-        {
-            auto bin = sIdx.mBins[i];
-            auto size = sIdx.mBinSizes[i];
+            // The special value assigned to the i'th bin.
+            r.resize(chunkBins, keyByteLength, oc::AllocType::Uninitialized);
+            mPrng.get<u8>(r);
 
-            for (u64 p = 0; p < size; ++p)
-            {
-                auto j = bin[p].hashIdx();
-                auto& hj = hashers[j];
-                auto b = bin[p].idx();
-                *TyIter = hj.hashBlock(Y[b]);
-                memcpy(&*TvIter, &*rIter, keyByteLength);
-                TvIter += keyByteLength;
+            // our shares are uniform mod the share type.
+            chunk.mValues.resize(chunkBins, values.cols(), oc::AllocType::Uninitialized);
+            if (mType == ValueShareType::modP)
+                sampleModP(mPrng, span<u64>((u64*)chunk.mValues.data(), chunk.mValues.size() / sizeof(u64)), mModulus);
+            else
+                mPrng.get<u8>(chunk.mValues);
 
-                if (values.size())
+            // fills the OPPRF inputs and values of bins [begin, end).
+            parallelFor(chunkBins, mNumThreads, [&](u64 begin, u64 end) {
+                BatchHasher hasher(hashers, Ty);
+                for (u64 i = begin; i < end; ++i)
                 {
-                    memcpy(&*TvIter, &values(b, 0), values.cols());
+                    auto bin = sIdx.mBins[i];
+                    auto size = sIdx.mBinSizes[i];
 
-                    if (mType == ValueShareType::Xor)
+                    for (u64 p = 0; p < size; ++p)
                     {
-                        for (u64 k = 0; k < values.cols(); ++k)
+                        auto j = bin[p].hashIdx();
+                        auto b = bin[p].idx();
+                        auto dest = binBegin[i] + p;
+                        hasher.push(j, Y[b], dest);
+
+                        auto tv = Tv[dest].data();
+                        memcpy(tv, r[i].data(), keyByteLength);
+                        tv += keyByteLength;
+
+                        if (values.size())
                         {
-                            TvIter[k] ^= ret.mValues(i, k);
+                            memcpy(tv, &values(b, 0), values.cols());
+                            auto rr = &chunk.mValues(i, 0);
+
+                            switch (mType)
+                            {
+                            case ValueShareType::Xor:
+                                for (u64 k = 0; k < values.cols(); ++k)
+                                    tv[k] ^= rr[k];
+                                break;
+                            case ValueShareType::add32:
+                                subWords<u32>(tv, rr, values.cols());
+                                break;
+                            case ValueShareType::add64:
+                                subWords<u64>(tv, rr, values.cols());
+                                break;
+                            case ValueShareType::modP:
+                                subWordsModP(tv, rr, values.cols(), mModulus);
+                                break;
+                            }
                         }
                     }
-                    else if (mType == ValueShareType::add32)
-                    {
-                        assert(values.cols() % sizeof(u32) == 0);
-                        auto ss = values.cols() / sizeof(u32);
-                        auto tv = (u32*)&*TvIter;
-                        auto rr = (u32*)&ret.mValues(i, 0);
-                        for (u64 k = 0; k < ss; ++k)
-                            tv[k] -= rr[k];
-                    }
-                    else
-                    {
-                        co_await chl.close();
-                        throw RTE_LOC;
-                    }
-                    TvIter += values.cols();
                 }
+            });
 
-                ++TyIter;
-            }
-            rIter += keyByteLength;
-        }
+            // the unused OPPRF inputs are random.
+            for (u64 k = binBegin.back(); k < Ty.size(); ++k)
+                Ty[k] = mPrng.get();
 
-        while (TyIter != Ty.end())
-        {
-            *TyIter = mPrng.get();
-            ++TyIter;
-        }
+            setTimePoint("RsCpsiSender::send setValues");
 
-        setTimePoint("RsCpsiSender::send setValues");
+            opprf = std::make_unique<RsOpprfSender>();
+            if (mTimer)
+                opprf->setTimer(*mTimer);
 
-        if (mTimer)
-            opprf->setTimer(*mTimer);
+            co_await (opprf->send(chunkBins, Ty, Tv, mPrng, mNumThreads, chl));
+            co_await (triples);
 
-        co_await (opprf->send(numBins, Ty, Tv, mPrng, mNumThreads, chl));
+            cmp->setInput(0, r);
+            if (mAggregate)
+            {
+                // our value shares and the output masks, see cpsiAggregateCircuit.
+                aggIn.resize(chunkBins, mNumCategories ? 2 : 1, oc::AllocType::Uninitialized);
+                for (u64 i = 0; i < chunkBins; ++i)
+                    std::memcpy(aggIn[i].data(), &chunk.mValues(i, 0), aggIn.cols() * sizeof(u32));
 
-        if (mTimer)
-            cmp->setTimer(*mTimer);
+                masks.resize(chunkBins, numAggregates(), oc::AllocType::Uninitialized);
+                mPrng.get<u32>(masks);
 
-        cir = isZeroCircuit(keyBitLength);
-        cmp->init(r.rows(), cir, mNumThreads, 1, mPrng.get());
+                cmp->setInput(1, aggIn);
+                cmp->setZeroInput(2);
+                cmp->setInput(3, masks);
+            }
+
+            co_await (cmp->run(chl));
+
+            if (mAggregate)
+            {
+                // The receiver learns the masked aggregates of each bin and
+                // sums them. Our share is minus the sum of the masks.
+                aggOut.resize(chunkBins, numAggregates(), oc::AllocType::Uninitialized);
+                cmp->getOutput(0, aggOut);
+                co_await (chl.send(std::move(aggOut)));
+
+                chunk.mAggregates.assign(numAggregates(), 0);
+                for (u64 i = 0; i < chunkBins; ++i)
+                    for (u64 k = 0; k < masks.cols(); ++k)
+                        chunk.mAggregates[k] -= masks(i, k);
+            }
+            else
+            {
+
+                auto ss = cmp->getOutputView(0);
+                chunk.mFlagBits.resize(chunkBins);
+                std::copy(ss.begin(), ss.begin() + chunk.mFlagBits.sizeBytes(), chunk.mFlagBits.data());
+            }
 
-        cmp->setInput(0, r);
-        co_await (cmp->run(chl));
+            deliverChunk(chunk, chunkBegin, numBins, ret, mChunkCallback);
+        }
 
+        if (mCompactBound)
         {
+            // our share of the receiver's index is zero.
+            table = compactTable(ret.mValues, std::vector<u32>(numBins));
+
+            if (mTimer)
+                compactor.setTimer(*mTimer);
+            compactor.init(mCompactBound, mNumThreads, 1, mPrng.get());
+            co_await (compactor.run(ret.mFlagBits, table, chl));
 
-            auto ss = cmp->getOutputView(0);
-            ret.mFlagBits.resize(numBins);
-            std::copy(ss.begin(), ss.begin() + ret.mFlagBits.sizeBytes(), ret.mFlagBits.data());
+            splitTable(table, ret.mValues, ret.mRecverIdx);
         }
     }
 
     Proto RsCpsiReceiver::receive(span<block> X, Sharing& ret, Socket& chl)
     {
         auto cuckooSeed = block{};
-            auto cuckoo = oc::CuckooIndex<>{};
+            auto cuckoo = CuckooBuilder{};
             auto Tx = std::vector<block>{};
             auto hashers = std::array<oc::AES, 3> {};
             auto numBins = u64{};
             auto keyBitLength = u64{};
             auto keyByteLength = u64{};
+            auto chunkSize = u64{};
+            auto chunkBegin = u64{};
+            auto chunkEnd = u64{};
+            auto chunkBins = u64{};
+            auto numPoints = u64{};
+            auto chunk = Sharing{};
             auto r = Matrix<u8>{};
-            auto opprf = std::make_unique<RsOpprfReceiver>();
-            auto cmp = std::make_unique<Gmw>();
+            auto opprf = std::unique_ptr<RsOpprfReceiver>{};
+            auto cmp = std::unique_ptr<Gmw>{};
             auto cir = BetaCircuit{};
+            auto fork = Socket{};
+            auto triples = macoro::eager_task<void>{};
+            auto aggIn = Matrix<u32>{};
+            auto aggOut = Matrix<u32>{};
+            auto senderOut = Matrix<u32>{};
+            auto compactor = Compactor{};
+            auto table = Matrix<u8>{};
+            auto idx = std::vector<u32>{};
 
         if (mRecverSize != X.size())
             throw RTE_LOC;
 
+        if (mValueByteLength && !validShareType(mType, mValueByteLength, mModulus))
+            throw RTE_LOC;
+
+        if (mAggregate && (mType != ValueShareType::add32 ||
+            mValueByteLength < sizeof(u32) * (mNumCategories ? 2 : 1)))
+            throw RTE_LOC;
+
+        if (mCompactBound && (mType != ValueShareType::Xor || mAggregate || mChunkCallback))
+            throw RTE_LOC;
+
         setTimePoint("RsCpsiReceiver::receive begin");
 
         cuckooSeed = mPrng.get();
         co_await (chl.send(std::move(cuckooSeed)));
-        cuckoo.init(mRecverSize, mSsp, 0, 3);
+        cuckoo.init(mRecverSize, mSsp, 3);
+        numBins = cuckoo.mNumBins;
+        keyBitLength = mSsp + oc::log2ceil(numBins);
+        keyByteLength = oc::divCeil(keyBitLength, 8);
+
+        cir = mAggregate ?
+            cpsiAggregateCircuit(keyBitLength, mNumCategories) :
+            isZeroCircuit(keyBitLength);
 
-        cuckoo.insert(X, cuckooSeed);
-        Tx.resize(cuckoo.mNumBins);
+        cuckoo.insert(X, cuckooSeed, mNumThreads);
 
         setTimePoint("RsCpsiReceiver::receive cuckoo");
 
@@ -178,63 +512,115 @@ namespace volePSI
         hashers[2].setKey(block(5677, 67867) ^ cuckooSeed);
 
         ret.mMapping.resize(X.size(), ~u64(0));
-        numBins = cuckoo.mBins.size();
         for (u64 i = 0; i < numBins; ++i)
+            if (cuckoo.isEmpty(i) == false)
+                ret.mMapping[cuckoo.idx(i)] = i;
+
+        // the chunks of bins, see RsCpsiSender::send.
+        chunkSize = mChunkSize ? std::min(mChunkSize, numBins) : numBins;
+        ret.mAggregates.assign(mAggregate ? numAggregates() : 0, 0);
+
+        for (chunkBegin = 0; chunkBegin < numBins; chunkBegin = chunkEnd)
         {
-            auto& bin = cuckoo.mBins[i];
-            if (bin.isEmpty() == false)
-            {
-                auto j = bin.hashIdx();
-                auto b = bin.idx();
-            
-                //j = oc::CuckooIndex<>::minCollidingHashIdx(i, cuckoo.mHashes[b], 3, numBins);
+            chunkEnd = std::min(numBins, chunkBegin + chunkSize);
+            chunkBins = chunkEnd - chunkBegin;
+            numPoints = chunkPoints(mSenderSize, numBins, chunkBegin, chunkEnd, mSsp);
+
+            // generate the GMW triples while the OPPRF is running, see RsCpsiSender::send.
+            cmp = std::make_unique<Gmw>();
+            if (mTimer)
+                cmp->setTimer(*mTimer);
+            cmp->init(chunkBins, cir, mNumThreads, 0, mPrng.get());
+            fork = chl.fork();
+            triples = cmp->generateTriple(1 << 20, 2, fork) | macoro::make_eager();
+
+            Tx.resize(chunkBins);
+            parallelFor(chunkBins, mNumThreads, [&](u64 begin, u64 end) {
+                BatchHasher hasher(hashers, Tx);
+                for (u64 i = begin; i < end; ++i)
+                {
+                    auto bin = chunkBegin + i;
+                    if (cuckoo.isEmpty(bin) == false)
+                        hasher.push(cuckoo.hashIdx(bin), X[cuckoo.idx(bin)], i);
+                    else
+                        Tx[i] = block(bin, 0);
+                }
+            });
+            setTimePoint("RsCpsiReceiver::receive values");
 
-                auto& hj = hashers[j];
-                Tx[i] = hj.hashBlock(X[b]);
-                ret.mMapping[b] = i;
-            }
-            else
-            {
-                Tx[i] = block(i, 0);
-            }
-        }
-        setTimePoint("RsCpsiReceiver::receive values");
+            r.resize(chunkBins, keyByteLength + mValueByteLength, oc::AllocType::Uninitialized);
 
-        keyBitLength = mSsp + oc::log2ceil(Tx.size());
-        keyByteLength = oc::divCeil(keyBitLength, 8);
+            opprf = std::make_unique<RsOpprfReceiver>();
+            if (mTimer)
+                opprf->setTimer(*mTimer);
 
-        r.resize(Tx.size(), keyByteLength + mValueByteLength, oc::AllocType::Uninitialized);
+            co_await (opprf->receive(numPoints, Tx, r, mPrng, mNumThreads, chl));
+            co_await (triples);
 
-        if (mTimer)
-            opprf->setTimer(*mTimer);
+            cmp->implSetInput(0, r, r.cols());
+            if (mAggregate)
+            {
+                // our value shares, see RsCpsiSender::send.
+                aggIn.resize(chunkBins, mNumCategories ? 2 : 1, oc::AllocType::Uninitialized);
+                for (u64 i = 0; i < chunkBins; ++i)
+                    std::memcpy(aggIn[i].data(), &r(i, keyByteLength), aggIn.cols() * sizeof(u32));
+
+                cmp->setZeroInput(1);
+                cmp->setInput(2, aggIn);
+                cmp->setZeroInput(3);
+            }
 
-        co_await (opprf->receive(mSenderSize * 3, Tx, r, mPrng, mNumThreads, chl));
+            co_await (cmp->run(chl));
 
-        if (mTimer)
-            cmp->setTimer(*mTimer);
+            if (mAggregate)
+            {
+                aggOut.resize(chunkBins, numAggregates(), oc::AllocType::Uninitialized);
+                senderOut.resize(chunkBins, numAggregates(), oc::AllocType::Uninitialized);
+                cmp->getOutput(0, aggOut);
+                co_await (chl.recv(senderOut));
+
+                chunk.mAggregates.assign(numAggregates(), 0);
+                for (u64 i = 0; i < chunkBins; ++i)
+                    for (u64 k = 0; k < aggOut.cols(); ++k)
+                        chunk.mAggregates[k] += aggOut(i, k) ^ senderOut(i, k);
+            }
+            else
+            {
+                auto ss = cmp->getOutputView(0);
 
-        cir = isZeroCircuit(keyBitLength);
-        cmp->init(r.rows(), cir, mNumThreads, 0, mPrng.get());
+                chunk.mFlagBits.resize(chunkBins);
+                std::copy(ss.begin(), ss.begin() + chunk.mFlagBits.sizeBytes(), chunk.mFlagBits.data());
 
-        cmp->implSetInput(0, r, r.cols());
+                chunk.mValues.resize(chunkBins, mValueByteLength, oc::AllocType::Uninitialized);
+                if (mValueByteLength)
+                {
+                    for (u64 i = 0; i < chunkBins; ++i)
+                    {
+                        std::memcpy(&chunk.mValues(i, 0), &r(i, keyByteLength), mValueByteLength);
+                    }
+                }
+            }
 
-        co_await (cmp->run(chl));
+            deliverChunk(chunk, chunkBegin, numBins, ret, mChunkCallback);
+        }
 
+        if (mCompactBound)
         {
-            auto ss = cmp->getOutputView(0);
+            idx.resize(numBins);
+            for (u64 i = 0; i < numBins; ++i)
+                idx[i] = cuckoo.isEmpty(i) ? ~u32(0) : u32(cuckoo.idx(i));
 
-            ret.mFlagBits.resize(numBins);
-            std::copy(ss.begin(), ss.begin() + ret.mFlagBits.sizeBytes(), ret.mFlagBits.data());
+            table = compactTable(ret.mValues, idx);
 
-            if (mValueByteLength)
-            {
-                ret.mValues.resize(numBins, mValueByteLength);
+            if (mTimer)
+                compactor.setTimer(*mTimer);
+            compactor.init(mCompactBound, mNumThreads, 0, mPrng.get());
+            co_await (compactor.run(ret.mFlagBits, table, chl));
 
-                for (u64 i = 0; i < numBins; ++i)
-                {
-                    std::memcpy(&ret.mValues(i, 0), &r(i, keyByteLength), mValueByteLength);
-                }
-            }
+            splitTable(table, ret.mValues, ret.mRecverIdx);
+
+            // the output rows no longer correspond to the bins.
+            ret.mMapping.clear();
         }
 
         setTimePoint("RsCpsiReceiver::receive done");
@@ -16,9 +16,12 @@
 #include "cryptoTools/Common/CuckooIndex.h"
 #include "volePSI/RsOpprf.h"
 #include "volePSI/GMW/Gmw.h"
+#include "volePSI/GMW/Compactor.h"
 #include "volePSI/SimpleIndex.h"
+#include "volePSI/CuckooBuilder.h"
 #include "cryptoTools/Common/Timer.h"
 #include "cryptoTools/Common/BitVector.h"
+#include <functional>
 
 namespace volePSI
 {
@@ -27,7 +30,13 @@ namespace volePSI
     enum ValueShareType
     {
         Xor,
-        add32
+        // additive shares mod 2^32 of each u32 word of the value.
+        add32,
+        // additive shares mod 2^64 of each u64 word of the value.
+        add64,
+        // additive shares mod RsCpsiBase::mModulus of each u64 word of
+        // the value. The words must be less than the modulus.
+        modP
     };
     namespace details
     {
@@ -42,6 +51,36 @@ namespace volePSI
             PRNG mPrng;
             ValueShareType mType = ValueShareType::Xor;
 
+            // the modulus of ValueShareType::modP, typically a prime.
+            u64 mModulus = 0;
+
+            // If set, the output is additive shares of aggregates over
+            // the intersection instead of the per bin sharing, see
+            // Sharing::mAggregates. They are computed in the same circuit
+            // as the comparison. Requires add32 values, the first u32 of
+            // each value is summed. Must be the same for both parties.
+            bool mAggregate = false;
+
+            // With mAggregate, the second u32 of each value is a category
+            // in [0, mNumCategories) and the aggregates are also grouped by it.
+            u64 mNumCategories = 0;
+
+            // the number of u32 aggregates, see Sharing::mAggregates.
+            u64 numAggregates() const { return 2 + 2 * mNumCategories; }
+
+            // If non-zero, the per bin sharing is obliviously compacted to
+            // this many rows with the intersection first, see Compactor.
+            // Should be an upper bound on the intersection size. Requires
+            // Xor values. Must be the same for both parties.
+            u64 mCompactBound = 0;
+
+            // If non-zero, the cuckoo bins are processed in chunks of this
+            // many bins, each with its own OPPRF and GMW. This bounds the
+            // memory by the chunk instead of the set sizes. The sender's
+            // OPPRF inputs of each chunk are padded to a bound on its load.
+            // Must be the same for both parties.
+            u64 mChunkSize = 0;
+
             void init(
                 u64 senderSize,
                 u64 recverSize,
@@ -73,7 +112,8 @@ namespace volePSI
             oc::BitVector mFlagBits;
 
             // Secret share of the values associated with the output
-            // elements. These values are from the sender.
+            // elements. These values are from the sender. The share
+            // type is mType.
             oc::Matrix<u8> mValues;
 
             // The mapping of the senders input rows to output rows.
@@ -81,8 +121,22 @@ namespace volePSI
             // possible output rows.
             std::vector<std::array<u64, 3>> mMapping;
 
+            // With mAggregate, the sender's additive share mod 2^32 of the
+            // count and the sum over the intersection, followed by the
+            // count and the sum of each category. mFlagBits is not set.
+            std::vector<u32> mAggregates;
+
+            // With mCompactBound, the XOR share of the receiver's input
+            // index of each output row. Only meaningful for the rows in
+            // the intersection.
+            std::vector<u32> mRecverIdx;
         };
 
+        // If set, called with the first bin and the output of each chunk
+        // when it is done, see RsCpsiBase::mChunkSize. The chunks are then
+        // not kept in the output, except for mAggregates.
+        std::function<void(u64 binBegin, Sharing& chunk)> mChunkCallback;
+
         // perform the join with Y being the join keys with associated values.
         // The output is written to s.
         Proto send(span<block> Y, oc::MatrixView<u8> values, Sharing& s, Socket& chl);
@@ -107,8 +161,20 @@ namespace volePSI
             // The mapping of the receiver's input rows to output rows.
             std::vector<u64> mMapping;
 
+            // With mAggregate, the receiver's share of the aggregates, see
+            // RsCpsiSender::Sharing::mAggregates. mFlagBits and mValues are not set.
+            std::vector<u32> mAggregates;
+
+            // With mCompactBound, the share of the input index of each row,
+            // see RsCpsiSender::Sharing::mRecverIdx. mMapping is not set.
+            std::vector<u32> mRecverIdx;
         };
 
+        // If set, called with the first bin and the output of each chunk,
+        // see RsCpsiSender::mChunkCallback. mMapping of the output is set
+        // before the first chunk.
+        std::function<void(u64 binBegin, Sharing& chunk)> mChunkCallback;
+
         // perform the join with X being the join keys.
         // The output is written to s.
         Proto receive(span<block> X, Sharing& s, Socket& chl);
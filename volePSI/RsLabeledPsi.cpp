@@ -0,0 +1,81 @@
+#include "RsLabeledPsi.h"
+#ifdef VOLE_PSI_ENABLE_OPPRF
+
+namespace volePSI
+{
+	void details::RsLabeledPsiBase::init(
+		u64 senderSize,
+		u64 recverSize,
+		u64 labelSize,
+		u64 statSecParam,
+		block seed,
+		u64 numThreads)
+	{
+		mSenderSize = senderSize;
+		mRecverSize = recverSize;
+		mLabelSize = labelSize;
+		mSsp = statSecParam;
+		mPrng.SetSeed(seed);
+		mNumThreads = numThreads;
+
+		// each of the receiver's items is a false positive with probability 2^-(8 * mTagSize).
+		mTagSize = oc::divCeil(mSsp + oc::log2ceil(mRecverSize), 8);
+	}
+
+	Proto RsLabeledPsiSender::run(span<const block> inputs, MatrixView<u8> labels, Socket& chl)
+	{
+		auto values = Matrix<u8>{};
+		auto i = u64{};
+
+		setTimePoint("RsLabeledPsiSender::run-begin");
+
+		if (inputs.size() != mSenderSize || labels.rows() != mSenderSize || labels.cols() != mLabelSize)
+			throw RTE_LOC;
+
+		// a zero tag followed by the label.
+		values.resize(mSenderSize, mTagSize + mLabelSize);
+		for (i = 0; i < mSenderSize; ++i)
+			memcpy(values[i].data() + mTagSize, labels[i].data(), mLabelSize);
+		setTimePoint("RsLabeledPsiSender::run-values");
+
+		if (mTimer)
+			mSender.setTimer(getTimer());
+
+		co_await(mSender.send(mRecverSize, inputs, values, mPrng, mNumThreads, chl));
+		setTimePoint("RsLabeledPsiSender::run-opprf");
+	}
+
+	Proto RsLabeledPsiReceiver::run(span<const block> inputs, Socket& chl)
+	{
+		auto outputs = Matrix<u8>{};
+		auto zero = std::vector<u8>{};
+		auto i = u64{};
+
+		setTimePoint("RsLabeledPsiReceiver::run-begin");
+
+		if (inputs.size() != mRecverSize)
+			throw RTE_LOC;
+
+		outputs.resize(mRecverSize, mTagSize + mLabelSize, oc::AllocType::Uninitialized);
+
+		if (mTimer)
+			mRecver.setTimer(getTimer());
+
+		co_await(mRecver.receive(mSenderSize, inputs, outputs, mPrng, mNumThreads, chl));
+		setTimePoint("RsLabeledPsiReceiver::run-opprf");
+
+		mIntersection.clear();
+		zero.resize(mTagSize);
+		for (i = 0; i < mRecverSize; ++i)
+		{
+			if (memcmp(outputs[i].data(), zero.data(), mTagSize) == 0)
+				mIntersection.push_back(i);
+		}
+
+		mLabels.resize(mIntersection.size(), mLabelSize, oc::AllocType::Uninitialized);
+		for (i = 0; i < mIntersection.size(); ++i)
+			memcpy(mLabels[i].data(), outputs[mIntersection[i]].data() + mTagSize, mLabelSize);
+		setTimePoint("RsLabeledPsiReceiver::run-end");
+	}
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include "volePSI/config.h"
+#ifdef VOLE_PSI_ENABLE_OPPRF
+
+#include "volePSI/RsOpprf.h"
+#include "cryptoTools/Common/Timer.h"
+
+namespace volePSI
+{
+    namespace details
+    {
+        struct RsLabeledPsiBase
+        {
+            u64 mSenderSize = 0;
+            u64 mRecverSize = 0;
+            u64 mLabelSize = 0;
+            u64 mSsp = 0;
+            PRNG mPrng;
+            u64 mNumThreads = 0;
+
+            // The number of zero bytes in front of each label. The receiver
+            // keeps the items that decode to a zero tag.
+            u64 mTagSize = 0;
+
+            void init(u64 senderSize, u64 recverSize, u64 labelSize, u64 statSecParam, block seed, u64 numThreads);
+        };
+    }
+
+    // Labeled PSI. The sender has a label of labelSize bytes for each of
+    // its items and the receiver learns the labels of the items in the
+    // intersection. The sender programs a zero tag followed by the label
+    // under each of its items with one RsOpprf, i.e. one RsOprf of the
+    // receiver's set and one Baxos of the sender's set. The receiver's
+    // other items decode to random values and so have a non-zero tag
+    // except with probability 2^-ssp. The cost is close to RsPsi, without
+    // the cuckoo hashing and GMW of RsCpsi.
+    class RsLabeledPsiSender : public details::RsLabeledPsiBase, public oc::TimerAdapter
+    {
+    public:
+        RsOpprfSender mSender;
+        void setMultType(oc::MultType type) { mSender.setMultType(type); };
+
+        // labels has one row of labelSize bytes per input.
+        Proto run(span<const block> inputs, MatrixView<u8> labels, Socket& chl);
+    };
+
+    class RsLabeledPsiReceiver : public details::RsLabeledPsiBase, public oc::TimerAdapter
+    {
+    public:
+        RsOpprfReceiver mRecver;
+        void setMultType(oc::MultType type) { mRecver.setMultType(type); };
+
+        // The indices of the intersection and, in the same order, their labels.
+        std::vector<u64> mIntersection;
+        Matrix<u8> mLabels;
+
+        Proto run(span<const block> inputs, Socket& chl);
+    };
+}
+#endif
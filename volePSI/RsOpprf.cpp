@@ -1,8 +1,105 @@
 #include "RsOpprf.h"
+#include <thread>
 
 
 namespace volePSI
 {
+	namespace
+	{
+		// calls fn(begin, end) for numThreads disjoint sub-ranges of [0, n).
+		template<typename Fn>
+		void parallelFor(u64 n, u64 numThreads, Fn&& fn)
+		{
+			numThreads = std::max<u64>(1, std::min<u64>(numThreads, oc::divCeil(n, 1 << 12)));
+			std::vector<std::thread> thrds(numThreads - 1);
+			for (u64 i = 1; i < numThreads; ++i)
+				thrds[i - 1] = std::thread([&, i]() {
+					fn(i * n / numThreads, (i + 1) * n / numThreads);
+				});
+
+			fn(0, n / numThreads);
+
+			for (auto& t : thrds)
+				t.join();
+		}
+
+		// out[i] = add[i] ^ expand(keys[i]), where each row is m bytes and
+		// expand(k) is AES_k(0) || AES_k(1) || ... truncated to m bytes, the
+		// counter being the low word. If add is null, out[i] = expand(keys[i]).
+		// Eight keys are expanded at once with MultiKeyAES so that their
+		// key schedules and rounds are pipelined.
+		void addExpansion(span<const block> keys, u8* out, const u8* add, u64 m)
+		{
+			constexpr u64 batchSize = 8;
+			auto n = keys.size();
+			auto numBlocks = oc::divCeil(m, sizeof(block));
+			auto main = n / batchSize * batchSize;
+
+			std::array<block, batchSize> ctr, enc;
+			oc::MultiKeyAES<batchSize> aes;
+
+			auto xorRow = [&](u64 i, u64 j, const block& b) {
+				auto begin = j * sizeof(block);
+				auto size = std::min<u64>(sizeof(block), m - begin);
+				auto o = out + i * m + begin;
+				auto bb = (const u8*)&b;
+				if (add)
+				{
+					auto a = add + i * m + begin;
+					for (u64 k = 0; k < size; ++k)
+						o[k] = a[k] ^ bb[k];
+				}
+				else
+					memcpy(o, bb, size);
+			};
+
+			for (u64 i = 0; i < main; i += batchSize)
+			{
+				aes.setKeys({ (block*)keys.data() + i, batchSize });
+				for (u64 j = 0; j < numBlocks; ++j)
+				{
+					ctr.fill(block(0, j));
+					aes.ecbEncNBlocks(ctr.data(), enc.data());
+					for (u64 k = 0; k < batchSize; ++k)
+						xorRow(i + k, j, enc[k]);
+				}
+			}
+
+			std::vector<block> counters(numBlocks), buffer(numBlocks);
+			for (u64 j = 0; j < numBlocks; ++j)
+				counters[j] = block(0, j);
+			for (u64 i = main; i < n; ++i)
+			{
+				oc::AES aes1(keys[i]);
+				aes1.ecbEncBlocks(counters.data(), numBlocks, buffer.data());
+				for (u64 j = 0; j < numBlocks; ++j)
+					xorRow(i, j, buffer[j]);
+			}
+		}
+
+		// out[i] = add[i] ^ expand(oprfOutput[i]), where each row is m bytes.
+		void addOprf(span<const block> oprfOutput, u8* out, const u8* add, u64 m)
+		{
+			auto n = oprfOutput.size();
+			if (m <= sizeof(block))
+			{
+				// short string case
+				for (u64 i = 0, ij = 0; i < n; ++i)
+				{
+					for (u64 j = 0; j < m; ++j, ++ij)
+					{
+						out[ij] = add[ij] ^ oprfOutput[i].get<u8>(j);
+					}
+				}
+			}
+			else
+			{
+				// long string case
+				addExpansion(oprfOutput, out, add, m);
+			}
+		}
+	}
+
 	void RsOpprfSender::oprfEval(span<const block> X, span<u8> out, span<const u8> add, u64 m, u64 numThreads)
 	{
 		auto n = X.size();
@@ -23,31 +120,7 @@ namespace volePSI
 
 		mOprfSender.eval(X, oprfOutput, numThreads);
 
-		if (m <= sizeof(block))
-		{
-			// short string case
-			for (u64 i = 0, ij = 0; i < n; ++i)
-			{
-				for (u64 j = 0; j < m; ++j, ++ij)
-				{
-					out[ij] = add[ij] ^ oprfOutput[i].get<u8>(j);
-				}
-			}
-		}
-		else if (m > sizeof(block))
-		{
-			// long string case
-
-			std::vector<block> buffer(oc::divCeil(m, sizeof(block)));
-			auto buffPtr = (u8*)buffer.data();
-			for (u64 i = 0, ij = 0; i < n; ++i)
-			{
-				oc::AES enc(oprfOutput[i]);
-				enc.ecbEncCounterMode(0, buffer);
-				for (u64 j = 0; j < m; ++j, ++ij)
-					out[ij] = add[ij] ^ buffPtr[j];
-			}
-		}
+		addOprf(oprfOutput, out.data(), add.data(), m);
 	}
 
 
@@ -80,6 +153,7 @@ namespace volePSI
 
 		if (mTimer)
 			mOprfSender.setTimer(*mTimer);
+		mOprfSender.mStripes = mStripes;
 
 		co_await(mOprfSender.send(recverSize, prng, chl, numThreads));
 
@@ -128,7 +202,10 @@ namespace volePSI
 
 		setTimePoint("RsOpprfSender::send paxos solve");
 
-		co_await(chl.send(coproto::copy(mP)));
+		if (mStripes.size())
+			co_await(sendStriped(chl, mStripes, span<u8>(mP.data(), mP.size())));
+		else
+			co_await(chl.send(coproto::copy(mP)));
 
 		setTimePoint("RsOpprfSender::send end");
 
@@ -140,30 +217,51 @@ namespace volePSI
 
 		if (mPaxosByteWidth != m)
 			throw RTE_LOC;
+		if (val.size() != output.rows())
+			throw RTE_LOC;
 
 		MatrixView<u8> P(mP.data(), mPaxos.size(), output.cols());
 
+		// each decode call allocates a batch buffer per bin, so the
+		// batches are large enough to amortize that.
+		auto batchSize = std::max<u64>({ 1ull << 12,
+			mPaxos.mNumBins * 512,
+			mOprfSender.mPaxos.mNumBins * 512 });
+
 		setTimePoint("RsOpprfSender::eval begin");
-		if (m == sizeof(block))
-		{
-			// spacial case for block
-			auto oo = span<block>((block*)output.data(), output.rows());
-			auto pp = span<block>((block*)P.data(), P.rows());
-			mPaxos.decode<block>(val, oo, pp);
-		}
-		else
-		{
-			mPaxos.decode<u8>(val, output, P);
-		}
 
-		setTimePoint("RsOpprfSender::eval paxos decode");
+		// output = decode(val) + oprf(val). Each thread does both decodes and
+		// the OPRF hashing of a batch of its range before the next batch.
+		parallelFor(val.size(), numThreads, [&](u64 begin, u64 end) {
+			std::vector<block> oprfOutput(std::min<u64>(batchSize, end - begin));
 
-		// output +=  oprf(val)
-		auto outU8 = span<u8>(output.data(), output.size());
-		oprfEval(val, outU8, outU8, m, numThreads);
+			for (u64 i = begin; i < end; i += batchSize)
+			{
+				auto n = std::min<u64>(batchSize, end - i);
+				auto v = val.subspan(i, n);
+				auto o = MatrixView<u8>(output.data() + i * m, n, m);
+				auto oo = span<block>(oprfOutput.data(), n);
 
-		setTimePoint("RsOpprfSender::eval end");
+				if (m == sizeof(block))
+				{
+					// spacial case for block
+					auto ob = span<block>((block*)o.data(), n);
+					auto pp = span<block>((block*)P.data(), P.rows());
+					mPaxos.decode<block>(v, ob, pp, 1);
+				}
+				else
+				{
+					mPaxos.decode<u8>(v, o, P, 1);
+				}
 
+				mOprfSender.mPaxos.decode<block>(v, oo, mOprfSender.mB, 1);
+				mOprfSender.evalHash(v, oo);
+
+				addOprf(oo, o.data(), o.data(), m);
+			}
+		});
+
+		setTimePoint("RsOpprfSender::eval end");
 	}
 
 
@@ -196,6 +294,7 @@ namespace volePSI
 
 		if (mTimer)
 			mOprfReceiver.setTimer(*mTimer);
+		mOprfReceiver.mStripes = mStripes;
 
 		if (outputs.cols() >= sizeof(block))
 		{
@@ -222,7 +321,7 @@ namespace volePSI
 
 
 		p.resize(paxos.size(), m, oc::AllocType::Uninitialized);
-		co_await chl.recv(p);
+		co_await(recvStriped(chl, mStripes, span<u8>(p.data(), p.size())));
 		setTimePoint("RsOpprfReceiver::receive recv");
 
 		if (m == sizeof(block))
@@ -239,15 +338,8 @@ namespace volePSI
 			if (m > sizeof(block))
 			{
 
-				std::vector<block> buffer(oc::divCeil(m, sizeof(block)));
-				auto buffPtr = (u8*)buffer.data();
-
-				for (u64 i = 0; i < n; ++i)
-				{
-					oc::AES enc(oprfOutput[i]);
-					enc.ecbEncCounterMode(0, buffer);
-					memcpy(&outputs(i * m), buffPtr, m);
-				}
+				// must match the sender's expansion, see addOprf(...).
+				addExpansion(oprfOutput, outputs.data(), nullptr, m);
 			}
 			else
 			{
@@ -93,6 +93,9 @@ namespace volePSI
 		RsOprfSender mOprfSender;
 		void setMultType(oc::MultType type) { mOprfSender.setMultType(type); };
 
+		// Extra sockets that the large messages are striped over, see sendStriped(...).
+		std::vector<Socket> mStripes;
+
 		//struct PP
 		//{
 		//	u8* mData = nullptr;
@@ -172,6 +175,9 @@ namespace volePSI
 		RsOprfReceiver mOprfReceiver;
 		void setMultType(oc::MultType type) { mOprfReceiver.setMultType(type); };
 
+		// Extra sockets that the large messages are striped over, see sendStriped(...).
+		std::vector<Socket> mStripes;
+
 		Proto receive(u64 senderSize, span<const block> values, span<block> outputs, PRNG& prng, u64 numThreads, Socket& chl)
 		{
 			return receive(senderSize, values, MatrixView<u8>((u8*)outputs.data(), outputs.size(), sizeof(block)), prng, numThreads, chl);
@@ -109,7 +109,7 @@ namespace volePSI
 				remB = remB.subspan(subPp.size());
 
 				setTimePoint("RsOprfSender::pre*-" + std::to_string(recvIdx));
-				co_await chl.recv(subPp);
+				co_await(recvStriped(chl, mStripes, subPp));
 				setTimePoint("RsOprfSender::recv-" + std::to_string(recvIdx));
 
 				{
@@ -159,6 +159,17 @@ namespace volePSI
 
 		setTimePoint("RsOprfSender::eval-decode");
 
+		evalHash(val, output);
+
+		setTimePoint("RsOprfSender::eval-hash");
+
+	}
+
+	void RsOprfSender::evalHash(span<const block> val, span<block> output)
+	{
+		if (val.size() != output.size())
+			throw RTE_LOC;
+
 		auto main = val.size() / 8 * 8;
 		auto o = output.data();
 		auto v = val.data();
@@ -239,9 +250,6 @@ namespace volePSI
 				output[i] = oc::mAesFixedKey.hashBlock(output[i]);
 			}
 		}
-
-		setTimePoint("RsOprfSender::eval-hash");
-
 	}
 
 	Proto RsOprfSender::genVole(PRNG& prng, Socket& chl, bool reduceRounds)
@@ -281,13 +289,23 @@ namespace volePSI
 		auto fu = macoro::eager_task<void>{};
 		auto ii = u64{ 0 };
 		auto fork = Socket{};
+		auto cached = bool{};
 
 		setTimePoint("RsOprfReceiver::receive-begin");
 
 		if (values.size() != outputs.size())
 			throw RTE_LOC;
 
-		hashingSeed = prng.get(), wr = prng.get();
+		cached = mReuseSolve && mCachedP;
+		if (cached)
+		{
+			if (values.size() != mCachedValues.size() ||
+				std::memcmp(values.data(), mCachedValues.data(), values.size_bytes()))
+				throw std::runtime_error("RsOprfReceiver: the values differ from the cached solve, call clearSolveCache() first. " LOCATION);
+			hashingSeed = mCachedSeed, wr = prng.get();
+		}
+		else
+			hashingSeed = prng.get(), wr = prng.get();
 		paxos.mDebug = mDebug;
 		paxos.init(values.size(), mBinSize, 3, mSsp, PaxosParam::GF128, hashingSeed);
 
@@ -308,21 +326,42 @@ namespace volePSI
 
 
 
-		hPtr.reset(new block[values.size()]);
-		h = span<block>(hPtr.get(), values.size());
+		if (cached)
+		{
+			// p is masked in place below, so the cache is copied.
+			if (paxos.size() != mCachedPaxosSize)
+				throw std::runtime_error("RsOprfReceiver: the paxos parameters changed since the cached solve. " LOCATION);
+			p.resize(paxos.size());
+			std::memcpy(p.data(), mCachedP.get(), p.size() * sizeof(block));
+			setTimePoint("RsOprfReceiver::receive-cached");
+		}
+		else
+		{
+			hPtr.reset(new block[values.size()]);
+			h = span<block>(hPtr.get(), values.size());
+
+			oc::mAesFixedKey.hashBlocks(values, h);
+			setTimePoint("RsOprfReceiver::receive-hash");
 
-		oc::mAesFixedKey.hashBlocks(values, h);
-		setTimePoint("RsOprfReceiver::receive-hash");
+			//auto pPtr = std::make_shared<std::vector<block>>(paxos.size());
+			//span<block> p = *pPtr;
 
-		//auto pPtr = std::make_shared<std::vector<block>>(paxos.size());
-		//span<block> p = *pPtr;
+			p.resize(paxos.size());
 
-		p.resize(paxos.size());
+			setTimePoint("RsOprfReceiver::receive-alloc");
 
-		setTimePoint("RsOprfReceiver::receive-alloc");
+			paxos.solve<block>(values, h, p, nullptr, numThreads);
+			setTimePoint("RsOprfReceiver::receive-solve");
 
-		paxos.solve<block>(values, h, p, nullptr, numThreads);
-		setTimePoint("RsOprfReceiver::receive-solve");
+			if (mReuseSolve)
+			{
+				mCachedP.reset(new block[p.size()]);
+				std::memcpy(mCachedP.get(), p.data(), p.size() * sizeof(block));
+				mCachedValues.assign(values.begin(), values.end());
+				mCachedPaxosSize = p.size();
+				mCachedSeed = paxos.mSeed;
+			}
+		}
 		co_await(fu);
 
 		// a + b  = c * d
@@ -408,7 +447,9 @@ namespace volePSI
 
 				setTimePoint("RsOprfReceiver::receive-xor");
 
-				if (p.size() != subP.size())
+				if (mStripes.size())
+					co_await(sendStriped(chl, mStripes, subP));
+				else if (p.size() != subP.size())
 					co_await(chl.send(std::move(subP)));
 				else
 					co_await(chl.send(std::move(p)));
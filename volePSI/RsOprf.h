@@ -9,6 +9,7 @@
 
 #include "volePSI/Defines.h"
 #include "volePSI/Paxos.h"
+#include "volePSI/StripedSocket.h"
 #include "libOTe/Vole/Silent/SilentVoleSender.h"
 #include "libOTe/Vole/Silent/SilentVoleReceiver.h"
 
@@ -28,6 +29,9 @@ namespace volePSI
         u64 mSsp = 40;
         bool mDebug = false;
 
+        // Extra sockets that the large messages are striped over, see sendStriped(...).
+        std::vector<Socket> mStripes;
+
         void setMultType(oc::MultType type) { mVoleSender.mMultType = type; };
 
         Proto send(u64 n, PRNG& prng, Socket& chl, u64 mNumThreads = 0, bool reducedRounds = false);
@@ -38,6 +42,10 @@ namespace volePSI
 
         void eval(span<const block> val, span<block> output, u64 mNumThreads = 0);
 
+        // The second half of eval(...), output should hold the decode of val.
+        // Does not set time points so that it can be called from several threads.
+        void evalHash(span<const block> val, span<block> output);
+
 
         Proto genVole(PRNG& prng, Socket& chl, bool reducedRounds);
     };
@@ -54,6 +62,26 @@ namespace volePSI
         u64 mSsp = 40;
         bool mDebug = false;
 
+        // Extra sockets that the large messages are striped over, see sendStriped(...).
+        std::vector<Socket> mStripes;
+
+        // If set, the hashing seed and the solved paxos P of the first call
+        // to receive(...) are kept and reused by later calls with the same
+        // values in the same order, e.g. when one set is intersected with
+        // many senders. Each call still runs a fresh VOLE and sends P + C,
+        // which is a one-time pad of P, so only the solve is saved. The
+        // values are kept to check this and calls with different values
+        // throw, see clearSolveCache().
+        bool mReuseSolve = false;
+
+        // Drop the cached solve so that the next receive(...) solves again.
+        void clearSolveCache()
+        {
+            mCachedP.reset();
+            mCachedValues = {};
+            mCachedPaxosSize = 0;
+        }
+
         void setMultType(oc::MultType type) { mVoleRecver.mMultType = type; };
 
         Proto receive(span<const block> values, span<block> outputs, PRNG& prng, Socket& chl, u64 mNumThreads = 0, bool reducedRounds = false);
@@ -61,5 +89,12 @@ namespace volePSI
 
         Proto genVole(u64 n, PRNG& prng, Socket& chl, bool reducedRounds);
 
+    private:
+
+        // the cached solve, see mReuseSolve.
+        std::unique_ptr<block[]> mCachedP;
+        std::vector<block> mCachedValues;
+        u64 mCachedPaxosSize = 0;
+        block mCachedSeed;
     };
 }
\ No newline at end of file
@@ -1,6 +1,16 @@
 #include "RsPsi.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
 #include <future>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "volePSI/SimdHashTable.h"
+#include "volePSI/HashCodec.h"
 //#include "thirdparty/parallel-hashmap/parallel_hashmap/phmap.h"
 namespace volePSI
 {
@@ -43,103 +53,467 @@ namespace volePSI
 		mUseReducedRounds = useReducedRounds;
 	}
 
+	namespace
+	{
+		// The settings that must be the same for both parties.
+		std::array<u64, 2> sharedParams(const details::RsPsiBase& base)
+		{
+			return { base.mHashChunkSize, base.mEncodeHashes };
+		}
+
+		// The rows per chunk of the sender's hashes. HashCodec saves about
+		// log2 of the rows per hash so encoded hashes are sent as one chunk.
+		u64 hashChunkRows(const details::RsPsiBase& base)
+		{
+			if (base.mEncodeHashes)
+				return std::max<u64>(1, base.mSenderSize);
+			return std::max<u64>(1, std::min<u64>(base.mHashChunkSize, base.mSenderSize));
+		}
+
+		// sends our settings and receives the other party's.
+		Proto exchangeParams(Socket& chl, std::array<u64, 2> mine, std::array<u64, 2>& theirs)
+		{
+			co_await(chl.send(std::move(mine)));
+			co_await(chl.recv(theirs));
+		}
+	}
+
 	Proto RsPsiSender::run(span<block> inputs, Socket& chl)
 	{
 
-		auto hashes = Buffer<u8>{};
+		auto hashes = Buffer<block>{};
+		auto subHashes = span<u8>{};
+		auto chunkRows = u64{};
+		auto numChunks = u64{};
+		auto k = u64{};
+		auto encoded = std::array<std::vector<u64>, 2>{};
+		auto evalChunk = std::function<span<u8>(u64)>{};
+		auto fu = std::future<span<u8>>{};
+		auto fork = Socket{};
+		auto theirParams = std::array<u64, 2>{};
+		auto paramsFu = macoro::eager_task<void>{};
 		setTimePoint("RsPsiSender::run-begin");
 
+		if (inputs.size() != mSenderSize)
+			throw RTE_LOC;
+
 		if (mTimer)
 			mSender.setTimer(getTimer());
 
 		mSender.mMalicious = mMalicious;
 		mSender.mSsp = mSsp;
 		mSender.mDebug = mDebug;
+		mSender.mStripes = mStripes;
+
+		// the settings are checked on a fork while the OPRF runs.
+		fork = chl.fork();
+		paramsFu = exchangeParams(fork, sharedParams(*this), theirParams) | macoro::make_eager();
 
 		co_await mSender.send(mRecverSize, mPrng, chl, mNumThreads, mUseReducedRounds);
 
+		co_await(paramsFu);
+		if (theirParams != sharedParams(*this))
+			throw std::runtime_error("RsPsiSender: mHashChunkSize and mEncodeHashes must be the same for both parties. " LOCATION);
+
 		setTimePoint("RsPsiSender::run-opprf");
 
-		hashes.resize(inputs.size() * sizeof(block));
-		mSender.eval(inputs, span<block>((block*)hashes.data(), inputs.size()), mNumThreads);
+		// The hashes are evaluated, truncated and sent in chunks of
+		// mHashChunkSize rows. Chunk k + 1 is evaluated on another 
+		// thread while chunk k is being sent. There are two chunk 
+		// buffers, chunk k uses buffer k % 2. If mEncodeHashes is set
+		// all hashes are compressed with HashCodec as a single chunk.
+		chunkRows = hashChunkRows(*this);
+		numChunks = oc::divCeil(mSenderSize, chunkRows);
+		hashes.resize(std::min<u64>(numChunks, 2) * chunkRows);
+
+		evalChunk = [&](u64 idx) {
+			auto begin = idx * chunkRows;
+			auto size = std::min<u64>(chunkRows, mSenderSize - begin);
+			auto src = hashes.data() + (idx % 2) * chunkRows;
+			mSender.eval(inputs.subspan(begin, size), span<block>(src, size), mNumThreads);
+
+			if (mEncodeHashes)
+			{
+				auto& buff = encoded[idx % 2];
+				HashCodec codec;
+				codec.init(size, mMaskSize);
+				buff.resize(codec.encodedSize());
+				codec.encode(span<const block>(src, size), buff);
+				return span<u8>((u8*)buff.data(), buff.size() * sizeof(u64));
+			}
 
-		setTimePoint("RsPsiSender::run-eval");
-		if (mCompress)
-		{
-			auto src = (block*)hashes.data();
-			auto dest = (u8*)hashes.data();
-			u64 i = 0;
+			if (!mCompress)
+				return span<u8>((u8*)src, size * sizeof(block));
 
-			for (; i < std::min<u64>(mSenderSize, 100); ++i)
+			// truncate in place. The first rows overlap.
+			auto dest = (u8*)src;
+			u64 i = 0;
+			for (; i < std::min<u64>(size, 100); ++i)
 			{
 				memmove(dest, src, mMaskSize);
 				dest += mMaskSize;
 				src += 1;
 			}
-			for (; i < mSenderSize; ++i)
+			for (; i < size; ++i)
 			{
 				memcpy(dest, src, mMaskSize);
 				dest += mMaskSize;
 				src += 1;
 			}
-			static_cast<span<u8>&>(hashes) = span<u8>((u8*)hashes.data(), dest);
+			return span<u8>((u8*)(hashes.data() + (idx % 2) * chunkRows), dest);
+		};
+
+		if (numChunks)
+			fu = std::async(std::launch::async, evalChunk, 0);
+
+		for (k = 0; k < numChunks; ++k)
+		{
+			subHashes = fu.get();
+
+			// buffer (k + 1) % 2 is free since chunk k - 1 has been sent.
+			if (k + 1 < numChunks)
+				fu = std::async(std::launch::async, evalChunk, k + 1);
+
+			co_await(sendStriped(chl, mStripes, subHashes));
 		}
 
-		co_await chl.send(std::move(hashes));
 		setTimePoint("RsPsiSender::run-sendHash");
 
 	}
 
-	namespace {
-		struct NoHash
+	namespace
+	{
+		// receives the hashes of one chunk and decodes them if needed.
+		Proto recvHashes(Socket& chl, span<Socket> stripes, MatrixView<u8> dest, bool encoded, std::vector<u64>& buff)
+		{
+			auto codec = HashCodec{};
+			if (!encoded)
+			{
+				co_await(recvStriped(chl, stripes, span<u8>(dest.data(), dest.size())));
+			}
+			else
+			{
+				codec.init(dest.rows(), dest.cols());
+				buff.resize(codec.encodedSize());
+				co_await(recvStriped(chl, stripes, span<u64>(buff)));
+				codec.decode(buff, dest);
+			}
+		}
+
+		// The table key of a hash is its first maskSize bytes.
+		template<typename Key>
+		Key toKey(const u8* src, u64 maskSize)
 		{
-			inline size_t operator()(const block& v) const
+			Key k;
+			memset(&k, 0, sizeof(Key));
+			memcpy(&k, src, std::min<u64>(maskSize, sizeof(Key)));
+			return k;
+		}
+
+		// A single use barrier for a fixed number of threads.
+		struct Barrier
+		{
+			std::atomic<u64> mCount;
+			u64 mNumThreads = 0;
+			std::promise<void> mProm;
+			std::shared_future<void> mFu;
+
+			void init(u64 numThreads)
+			{
+				mCount = 0;
+				mNumThreads = numThreads;
+				mFu = mProm.get_future().share();
+			}
+
+			void arriveAndWait()
 			{
-				return v.get<size_t>(0);
+				if (++mCount == mNumThreads)
+					mProm.set_value();
+				else
+					mFu.get();
 			}
 		};
+
+		// Hands the chunks of the sender's hashes from the protocol to the
+		// worker threads. There are two buffers and chunk k is written to
+		// buffer k % 2 once all threads have released chunk k - 2.
+		struct ChunkPipe
+		{
+			std::mutex mMtx;
+			std::condition_variable mCv;
+			u64 mNumThreads = 0;
+			u64 mNumReady = 0;
+			std::array<u64, 2> mNumReleased;
+			bool mAborted = false;
+
+			void init(u64 numThreads)
+			{
+				mNumThreads = numThreads;
+				mNumReady = 0;
+				mNumReleased = { numThreads, numThreads };
+				mAborted = false;
+			}
+
+			// blocks until the buffer of chunk k can be written.
+			void acquire(u64 k)
+			{
+				std::unique_lock<std::mutex> lock(mMtx);
+				mCv.wait(lock, [&] { return mNumReleased[k % 2] == mNumThreads; });
+				mNumReleased[k % 2] = 0;
+			}
+
+			// chunk k has been written.
+			void publish(u64 k)
+			{
+				std::lock_guard<std::mutex> lock(mMtx);
+				mNumReady = k + 1;
+				mCv.notify_all();
+			}
+
+			// no more chunks will be written.
+			void abort()
+			{
+				std::lock_guard<std::mutex> lock(mMtx);
+				mAborted = true;
+				mCv.notify_all();
+			}
+
+			// blocks until chunk k is ready. Returns false if aborted.
+			bool wait(u64 k)
+			{
+				std::unique_lock<std::mutex> lock(mMtx);
+				mCv.wait(lock, [&] { return mNumReady > k || mAborted; });
+				return mNumReady > k;
+			}
+
+			// this thread is done with chunk k.
+			void release(u64 k)
+			{
+				std::lock_guard<std::mutex> lock(mMtx);
+				if (++mNumReleased[k % 2] == mNumThreads)
+					mCv.notify_all();
+			}
+		};
+
+		// A multi-threaded, one pass radix partition of n items into numParts
+		// partitions. Thread t is responsible for the items in [begin(t), end(t)).
+		// All threads first call count(...) and then, after a barrier, scatter(...).
+		struct RadixPartition
+		{
+			u64 mSize = 0, mNumParts = 0, mNumThreads = 0;
+
+			// mCounts[t * numParts + p] is the number of items of thread t in partition p.
+			std::vector<u64> mCounts;
+
+			// partition p is [mPartBegin[p], mPartBegin[p+1]). Set by scatter(...).
+			std::vector<u64> mPartBegin;
+
+			void init(u64 n, u64 numParts, u64 numThreads)
+			{
+				mSize = n;
+				mNumParts = numParts;
+				mNumThreads = numThreads;
+				mCounts.assign(numThreads * numParts, 0);
+				mPartBegin.assign(numParts + 1, 0);
+			}
+
+			u64 begin(u64 thrdIdx) const { return thrdIdx * mSize / mNumThreads; }
+			u64 end(u64 thrdIdx) const { return (thrdIdx + 1) * mSize / mNumThreads; }
+
+			template<typename PartFn>
+			void count(u64 thrdIdx, PartFn&& part)
+			{
+				auto counts = &mCounts[thrdIdx * mNumParts];
+				for (u64 i = begin(thrdIdx); i < end(thrdIdx); ++i)
+					++counts[part(i)];
+			}
+
+			// calls write(d, i) to move item i to position d.
+			template<typename PartFn, typename WriteFn>
+			void scatter(u64 thrdIdx, PartFn&& part, WriteFn&& write)
+			{
+				// where this thread writes into each partition.
+				std::vector<u64> offsets(mNumParts);
+				u64 partBegin = 0;
+				for (u64 p = 0; p < mNumParts; ++p)
+				{
+					for (u64 t = 0; t < mNumThreads; ++t)
+					{
+						if (t == thrdIdx)
+							offsets[p] = partBegin;
+						partBegin += mCounts[t * mNumParts + p];
+					}
+
+					if (!thrdIdx)
+						mPartBegin[p + 1] = partBegin;
+				}
+
+				for (u64 i = begin(thrdIdx); i < end(thrdIdx); ++i)
+					write(offsets[part(i)]++, i);
+			}
+		};
+
+		inline u64 lowWord(const u64& k) { return k; }
+		inline u64 lowWord(const block& k) { return k.get<u64>(0); }
+
+		inline bool keyLess(const u64& a, const u64& b) { return a < b; }
+		inline bool keyLess(const block& a, const block& b)
+		{
+			return a.get<u64>(1) < b.get<u64>(1) ||
+				(a.get<u64>(1) == b.get<u64>(1) && a.get<u64>(0) < b.get<u64>(0));
+		}
 	}
 
 	Proto RsPsiReceiver::run(span<block> inputs, Socket& chl)
 	{
+		// The truncated hashes are stored as u64 keys when they fit
+		// and the receiver indices as u32 when possible.
+		auto smallKey = mMaskSize <= sizeof(u64);
+		auto smallValue = mRecverSize < std::numeric_limits<u32>::max();
+
+		if (smallKey && smallValue)
+			return runImpl<u64, u32>(inputs, chl);
+		if (smallKey)
+			return runImpl<u64, u64>(inputs, chl);
+		if (smallValue)
+			return runImpl<block, u32>(inputs, chl);
+		return runImpl<block, u64>(inputs, chl);
+	}
+
+	bool RsPsiReceiver::useSortMerge() const
+	{
+		if (mIntersectType != PsiIntersectType::Auto)
+			return mIntersectType == PsiIntersectType::SortMerge;
+
+		// Sorting avoids the cache misses of probing a large hash table
+		// but touches both sets several times. It may win when both sets
+		// are large and of similar size, but this has not been measured, so
+		// the hash table is used until perfPSI -hash vs -sortMerge shows a
+		// crossover.
+		return false;
+	}
+
+	template<typename Key, typename Value>
+	Proto RsPsiReceiver::runImpl(span<block> inputs, Socket& chl)
+	{
+		using Table = SimdHashTable<Key, Value>;
+		struct Entry
+		{
+			Key mKey;
+			Value mValue;
+		};
+
 		setTimePoint("RsPsiReceiver::run-enter");
 		static const u64 batchSize = 128;
 
+		// The multi-threaded intersection. It has two modes.
+		//
+		// Hash: the receiver's hashes are radix partitioned by hash mod
+		// numThreads. Each thread then builds the table of one partition
+		// and finally probes a contiguous range of the sender's hashes
+		// against the table of each hash's partition. Every hash is 
+		// therefore touched once, independent of the number of threads.
+		// The sender's hashes are probed chunk by chunk as they arrive.
+		//
+		// SortMerge: both sides are radix partitioned into small buckets 
+		// by the low bits of the hash. Each thread then sorts its buckets 
+		// and merge joins them. No table memory and no random probes but
+		// all of the sender's hashes must be received first.
 		struct MultiThread
 		{
+			std::promise<void> oprfProm;
+			std::shared_future<void> oprfFu;
 			std::promise<void> prom;
 			std::shared_future<void> fu;
 			std::vector<std::thread> thrds;
 			std::function<void(u64)>routine;
-			std::atomic<u64> numDone;
-			std::promise<void> hashingDoneProm;
-			std::shared_future<void> hashingDoneFu;
-			std::mutex mMergeMtx;
+			std::array<Barrier, 3> barriers;
+			std::atomic<bool> mFailed;
+			std::mutex mExMtx;
+			std::exception_ptr mEx;
 
 			u64 numThreads;
-			u64 binSize;
 			libdivide::libdivide_u32_t divider;
+
+			RadixPartition mine, theirs;
+
+			// hash mode, the partitioned keys/values and the tables.
+			std::unique_ptr<Key[]> keys;
+			std::unique_ptr<Value[]> values;
+			std::vector<Table> tables;
+			ChunkPipe pipe;
+
+			// sort merge mode, the bucketed hashes.
+			u64 bucketMask;
+			std::unique_ptr<Entry[]> myEntries;
+			std::unique_ptr<Key[]> theirKeys;
+
+			// the matches and the number of matches of each thread.
+			std::vector<std::vector<Value>> hits;
+			std::vector<u64> counts;
 		};
 
 		auto data = std::unique_ptr<u8[]>{};
 		auto myHashes = span<block>{};
 		auto theirHashes = oc::MatrixView<u8>{};
-		auto map = google::dense_hash_map<block, u64, NoHash>{};
+		auto chunkRows = u64{};
+		auto numChunks = u64{};
+		auto theirRows = u64{};
+		auto chunk = std::function<oc::MatrixView<u8>(u64)>{};
+		auto table = Table{};
 		auto i = u64{};
-		auto main = u64{};
-		auto hh = std::array<std::pair<block, u64>, 128> {};
+		auto k = u64{};
+		auto hashes = oc::MatrixView<u8>{};
+		auto keys = std::array<Key, batchSize>{};
+		auto values = std::array<Value, batchSize>{};
 		auto mt = std::unique_ptr<MultiThread>{};
-		auto mask = block{};
+		auto prepFu = std::future<void>{};
+		auto recvFu = macoro::eager_task<void>{};
+		auto fork = Socket{};
+		auto theirParams = std::array<u64, 2>{};
+		auto paramsFu = macoro::eager_task<void>{};
+		auto encoded = std::vector<u64>{};
+		auto ex = std::exception_ptr{};
+		auto sortMerge = useSortMerge();
+		auto bitmap = std::vector<u64>{};
+
+		// records a match of the receiver's item v. The worker threads 
+		// share the bitmap and set bits atomically. The bitmap is kept as
+		// whole words since a BitVector only allocates divCeil(n, 8) bytes.
+		auto onHit = [&](auto& hits, Value v) {
+			if (mOutput == PsiOutput::Indices)
+				hits.push_back(v);
+			else if (mOutput == PsiOutput::Bitmap)
+				std::atomic_ref<u64>(bitmap[v / 64]).fetch_or(1ull << (v % 64), std::memory_order_relaxed);
+		};
 
 		setTimePoint("RsPsiReceiver::run-begin");
 		mIntersection.clear();
+		mIntersectionBitmap = {};
+		mCardinality = 0;
+		if (mOutput == PsiOutput::Bitmap)
+			bitmap.resize(oc::divCeil(mRecverSize, 64));
+
+		// The sender's hashes arrive in chunks of chunkRows. The hash 
+		// intersection probes each chunk as it arrives and so only needs
+		// two chunk buffers. Sort-merge needs all of them.
+		chunkRows = hashChunkRows(*this);
+		numChunks = oc::divCeil(mSenderSize, chunkRows);
+		theirRows = sortMerge ? mSenderSize : std::min<u64>(numChunks, 2) * chunkRows;
 
 		data = std::unique_ptr<u8[]>(new u8[
-			mSenderSize * mMaskSize +
-				mRecverSize * sizeof(block)]);
+			theirRows * mMaskSize + mRecverSize * sizeof(block)]);
 
 		myHashes = span<block>((block*)data.get(), mRecverSize);
-		theirHashes = oc::MatrixView<u8>((u8*)((block*)data.get() + mRecverSize), mSenderSize, mMaskSize);
+		theirHashes = oc::MatrixView<u8>((u8*)((block*)data.get() + mRecverSize), 
+			theirRows, mMaskSize);
+
+		// the view of chunk k.
+		chunk = [&](u64 k) {
+			auto rows = std::min<u64>(chunkRows, mSenderSize - k * chunkRows);
+			auto begin = sortMerge ? k * chunkRows : (k % 2) * chunkRows;
+			return oc::MatrixView<u8>(theirHashes[begin].data(), rows, mMaskSize);
+		};
 
 		setTimePoint("RsPsiReceiver::run-alloc");
 
@@ -149,184 +523,381 @@ namespace volePSI
 		mRecver.mMalicious = mMalicious;
 		mRecver.mSsp = mSsp;
 		mRecver.mDebug = mDebug;
+		mRecver.mStripes = mStripes;
+		mRecver.mReuseSolve = mReuseSolve;
 
-		// todo, parallelize these two
-		co_await(mRecver.receive(inputs, myHashes, mPrng, chl, mNumThreads, mUseReducedRounds));
-		setTimePoint("RsPsiReceiver::run-opprf");
-
-		mask = oc::ZeroBlock;
-		for (i = 0; i < mMaskSize; ++i)
-			mask.set<u8>(i, ~0);
-
-		if (mNumThreads < 2)
+		// The table(s) are allocated while the OPRF is running. In the 
+		// multi-threaded case the worker threads are also started and 
+		// wait for the OPRF outputs.
+		if (mNumThreads < 2 && !sortMerge)
+		{
+			prepFu = std::async(std::launch::async, [&]() {
+				table.init(myHashes.size());
+				});
+		}
+		else
 		{
+			mt.reset(new MultiThread);
 
-			map.resize(myHashes.size());
-			setTimePoint("RsPsiReceiver::run-reserve");
-			map.set_empty_key(oc::ZeroBlock);
-			setTimePoint("RsPsiReceiver::run-set_empty_key");
+			mt->oprfFu = mt->oprfProm.get_future().share();
+			mt->fu = mt->prom.get_future().share();
+			mt->mFailed = false;
 
-			main = mRecverSize / batchSize * batchSize;
+			mt->numThreads = std::max<u64>(1, mNumThreads);
+			mt->divider = libdivide::libdivide_u32_gen(mt->numThreads);
+			for (auto& b : mt->barriers)
+				b.init(mt->numThreads);
+			mt->pipe.init(mt->numThreads);
+			mt->hits.resize(mt->numThreads);
+			mt->counts.resize(mt->numThreads);
 
-			if (!mCompress)
+			if (sortMerge)
 			{
-
-				for (i = 0; i < main; i += batchSize)
-				{
-					for (u64 j = 0; j < batchSize; ++j)
-						hh[j] = { myHashes[i + j], i + j };
-
-					map.insert(hh.begin(), hh.end());
-				}
-				for (; i < mRecverSize; ++i)
-					map.insert({ myHashes[i], i });
+				// buckets of about 2^10 items so that they are sorted in cache.
+				auto maxSize = std::max(mSenderSize, mRecverSize);
+				auto numBuckets = 1ull << std::min<u64>(14, oc::log2ceil(std::max<u64>(1, maxSize >> 10)));
+				mt->bucketMask = numBuckets - 1;
+				mt->mine.init(mRecverSize, numBuckets, mt->numThreads);
+				mt->theirs.init(mSenderSize, numBuckets, mt->numThreads);
+				mt->myEntries.reset(new Entry[mRecverSize]);
+				mt->theirKeys.reset(new Key[mSenderSize]);
 			}
 			else
 			{
+				mt->mine.init(mRecverSize, mt->numThreads, mt->numThreads);
+				mt->keys.reset(new Key[mRecverSize]);
+				mt->values.reset(new Value[mRecverSize]);
+				mt->tables.resize(mt->numThreads);
+			}
 
-				for (i = 0; i < main; i += batchSize)
+			mt->routine = [&](u64 thrdIdx)
 				{
-					for (u64 j = 0; j < batchSize; ++j)
-						hh[j] = { myHashes[i + j] & mask, i + j };
+					auto nt = mt->numThreads;
+					auto& divider = mt->divider;
+					auto partition = [&](const u8* h) -> u64 {
+						auto v = toKey<u32>(h, mMaskSize);
+						auto k = libdivide::libdivide_u32_do(v, &divider);
+						return v - k * nt;
+					};
+					auto bucket = [&](const u8* h) -> u64 {
+						return lowWord(toKey<Key>(h, mMaskSize)) & mt->bucketMask;
+					};
+					auto myHash = [&](u64 i) { return (const u8*)&myHashes[i]; };
+					auto theirHash = [&](u64 i) { return (const u8*)theirHashes[i].data(); };
+
+					// Run a phase unless a previous one failed. The barriers
+					// are always reached so that no thread blocks forever.
+					auto phase = [&](auto&& fn) {
+						if (mt->mFailed)
+							return;
+						try {
+							fn();
+						}
+						catch (...)
+						{
+							std::lock_guard<std::mutex> lock(mt->mExMtx);
+							if (!mt->mEx)
+								mt->mEx = std::current_exception();
+							mt->mFailed = true;
+						}
+					};
 
-					map.insert(hh.begin(), hh.end());
-				}
-				for (; i < mRecverSize; ++i)
-					map.insert({ myHashes[i] & mask, i });
-			}
+					if (sortMerge)
+					{
+						auto myBucket = [&](u64 i) { return bucket(myHash(i)); };
+						auto theirBucket = [&](u64 i) { return bucket(theirHash(i)); };
+
+						phase([&]() {
+							// wait for the OPRF outputs. The timer is not thread safe
+							// and is used by the OPRF until then.
+							mt->oprfFu.get();
+							mt->mine.count(thrdIdx, myBucket);
+							});
+						mt->barriers[0].arriveAndWait();
+
+						phase([&]() {
+							mt->mine.scatter(thrdIdx, myBucket, [&](u64 d, u64 i) {
+								mt->myEntries[d] = { toKey<Key>(myHash(i), mMaskSize), Value(i) };
+								});
+
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-scatter_par");
+
+							mt->fu.get();
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-recv_par");
+
+							mt->theirs.count(thrdIdx, theirBucket);
+							});
+						mt->barriers[1].arriveAndWait();
+
+						phase([&]() {
+							mt->theirs.scatter(thrdIdx, theirBucket, [&](u64 d, u64 i) {
+								mt->theirKeys[d] = toKey<Key>(theirHash(i), mMaskSize);
+								});
+							});
+						mt->barriers[2].arriveAndWait();
+
+						phase([&]() {
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-scatter2_par");
+
+							auto& hits = mt->hits[thrdIdx];
+							auto count = u64{};
+							auto numBuckets = mt->bucketMask + 1;
+							auto b = thrdIdx * numBuckets / nt;
+							auto e = (thrdIdx + 1) * numBuckets / nt;
+							for (u64 k = b; k < e; ++k)
+							{
+								auto mBegin = mt->myEntries.get() + mt->mine.mPartBegin[k];
+								auto mEnd = mt->myEntries.get() + mt->mine.mPartBegin[k + 1];
+								auto tBegin = mt->theirKeys.get() + mt->theirs.mPartBegin[k];
+								auto tEnd = mt->theirKeys.get() + mt->theirs.mPartBegin[k + 1];
+
+								std::sort(mBegin, mEnd, [](const Entry& x, const Entry& y) {
+									return keyLess(x.mKey, y.mKey);
+									});
+								std::sort(tBegin, tEnd, [](const Key& x, const Key& y) {
+									return keyLess(x, y);
+									});
+
+								// merge join. A match reports the first of
+								// the receiver's entries with that key.
+								while (mBegin != mEnd && tBegin != tEnd)
+								{
+									if (keyLess(mBegin->mKey, *tBegin))
+										++mBegin;
+									else if (keyLess(*tBegin, mBegin->mKey))
+										++tBegin;
+									else
+									{
+										onHit(hits, mBegin->mValue);
+										++count;
+										++tBegin;
+									}
+								}
+							}
+							mt->counts[thrdIdx] += count;
 
-			setTimePoint("RsPsiReceiver::run-insert");
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-merge_par");
+							});
+					}
+					else
+					{
+						auto myPart = [&](u64 i) { return partition(myHash(i)); };
+
+						phase([&]() {
+							// wait for the OPRF outputs. The timer is not thread safe
+							// and is used by the OPRF until then.
+							mt->oprfFu.get();
+							mt->mine.count(thrdIdx, myPart);
+							});
+						mt->barriers[0].arriveAndWait();
+
+						phase([&]() {
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-count_par");
+
+							mt->mine.scatter(thrdIdx, myPart, [&](u64 d, u64 i) {
+								mt->keys[d] = toKey<Key>(myHash(i), mMaskSize);
+								mt->values[d] = i;
+								});
+							});
+						mt->barriers[1].arriveAndWait();
+
+						phase([&]() {
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-scatter_par");
+
+							auto b = mt->mine.mPartBegin[thrdIdx];
+							auto e = mt->mine.mPartBegin[thrdIdx + 1];
+							auto& table = mt->tables[thrdIdx];
+							table.init(e - b);
+							table.insert(
+								span<const Key>(mt->keys.get() + b, e - b),
+								span<const Value>(mt->values.get() + b, e - b));
+							});
+						mt->barriers[2].arriveAndWait();
+
+						phase([&]() {
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-insert_par");
+							});
+
+						// each thread probes its share of every chunk.
+						for (u64 k = 0; k < numChunks && mt->pipe.wait(k); ++k)
+						{
+							phase([&]() {
+								auto& hits = mt->hits[thrdIdx];
+								auto count = u64{};
+								auto hashes = chunk(k);
+								std::array<Key, batchSize> keys;
+								std::array<u64, batchSize> parts;
+								auto b = thrdIdx * hashes.rows() / nt;
+								auto e = (thrdIdx + 1) * hashes.rows() / nt;
+								for (u64 i = b; i < e; i += batchSize)
+								{
+									auto n = std::min<u64>(batchSize, e - i);
+									for (u64 j = 0; j < n; ++j)
+									{
+										keys[j] = toKey<Key>(hashes[i + j].data(), mMaskSize);
+										parts[j] = partition(hashes[i + j].data());
+										mt->tables[parts[j]].prefetch(keys[j]);
+									}
+
+									for (u64 j = 0; j < n; ++j)
+									{
+										auto v = mt->tables[parts[j]].find(keys[j]);
+										if (v != Table::npos)
+										{
+											onHit(hits, v);
+											++count;
+										}
+									}
+								}
+								mt->counts[thrdIdx] += count;
+								});
+							mt->pipe.release(k);
+						}
 
-			co_await(chl.recv(theirHashes));
+						phase([&]() {
+							if (!thrdIdx)
+								setTimePoint("RsPsiReceiver::run-find_par");
+							});
+					}
+				};
 
-			setTimePoint("RsPsiReceiver::run-recv");
+			mt->thrds.resize(mt->numThreads);
+			for (i = 0; i < mt->thrds.size(); ++i)
+				mt->thrds[i] = std::thread(mt->routine, i);
+		}
 
-			{
-				block h = oc::ZeroBlock;
-				auto iter = theirHashes.data();
-				for (i = 0; i < mSenderSize; ++i)
-				{
-					memcpy(&h, iter, mMaskSize);
-					iter += mMaskSize;
+		// the settings are checked on a fork while the OPRF runs.
+		fork = chl.fork();
+		paramsFu = exchangeParams(fork, sharedParams(*this), theirParams) | macoro::make_eager();
 
-					auto iter = map.find(h);
-					if (iter != map.end())
-					{
-						mIntersection.push_back(iter->second);
-					}
-				}
-			}
+		try {
+			co_await(mRecver.receive(inputs, myHashes, mPrng, chl, mNumThreads, mUseReducedRounds));
 
-			setTimePoint("RsPsiReceiver::run-find");
+			co_await(paramsFu);
+			if (theirParams != sharedParams(*this))
+				throw std::runtime_error("RsPsiReceiver: mHashChunkSize and mEncodeHashes must be the same for both parties. " LOCATION);
 		}
-		else
+		catch (...)
 		{
-			mt.reset(new MultiThread);
+			ex = std::current_exception();
+		}
+		setTimePoint("RsPsiReceiver::run-opprf");
 
-			mt->fu = mt->prom.get_future().share();
+		if (!mt)
+		{
+			prepFu.get();
+			if (ex)
+				std::rethrow_exception(ex);
 
 			setTimePoint("RsPsiReceiver::run-reserve");
 
-			mt->numDone = 0;
-			mt->hashingDoneFu = mt->hashingDoneProm.get_future().share();
+			// receive the first chunk while the table is being filled.
+			if (numChunks)
+				recvFu = recvHashes(chl, mStripes, chunk(0), mEncodeHashes, encoded) | macoro::make_eager();
 
-			mt->numThreads = std::max<u64>(1, mNumThreads);
-			mt->binSize = Baxos::getBinSize(mNumThreads, mRecverSize, mSsp);
-			mt->divider = libdivide::libdivide_u32_gen(mt->numThreads);
-
-			mt->routine = [&](u64 thrdIdx)
+			for (i = 0; i < mRecverSize; i += batchSize)
+			{
+				auto n = std::min<u64>(batchSize, mRecverSize - i);
+				for (u64 j = 0; j < n; ++j)
 				{
-					if (!thrdIdx)
-						setTimePoint("RsPsiReceiver::run-threadBegin");
-
-					auto& divider = mt->divider;
-					google::dense_hash_map<block, u64, NoHash> map(mt->binSize);
-					map.set_empty_key(oc::ZeroBlock);
-
-					if (!thrdIdx)
-						setTimePoint("RsPsiReceiver::run-set_empty_key_par");
-
-					u64 i = 0;
-					std::array<std::pair<block, u64>, batchSize> hh;
-					for (; i < myHashes.size();)
-					{
-						u64 j = 0;
-						while (j != batchSize && i < myHashes.size())
-						{
-							auto v = myHashes[i].get<u32>(0);
-							auto k = libdivide::libdivide_u32_do(v, &divider);
-							v -= k * mNumThreads;
-							if (v == thrdIdx)
-							{
-								hh[j] = { myHashes[i] & mask, i };
-								++j;
-							}
-							++i;
-						}
-						map.insert(hh.begin(), hh.begin() + j);
-					}
+					keys[j] = toKey<Key>((u8*)&myHashes[i + j], mMaskSize);
+					values[j] = i + j;
+				}
 
-					if (++mt->numDone == mt->numThreads)
-						mt->hashingDoneProm.set_value();
-					else
-						mt->hashingDoneFu.get();
+				table.insert(span<const Key>(keys.data(), n), span<const Value>(values.data(), n));
+			}
 
-					if (!thrdIdx)
-						setTimePoint("RsPsiReceiver::run-insert_par");
+			setTimePoint("RsPsiReceiver::run-insert");
 
-					mt->fu.get();
-					if (!thrdIdx)
-						setTimePoint("RsPsiReceiver::run-recv_par");
+			// probe chunk k while chunk k + 1 is received.
+			for (k = 0; k < numChunks; ++k)
+			{
+				co_await(recvFu);
+				if (k + 1 < numChunks)
+					recvFu = recvHashes(chl, mStripes, chunk(k + 1), mEncodeHashes, encoded) | macoro::make_eager();
 
-					auto begin = thrdIdx * myHashes.size() / mNumThreads;
-					u64 intersectionSize = 0;
-					u64* intersection = (u64*)&myHashes[begin];
+				hashes = chunk(k);
+				for (i = 0; i < hashes.rows(); i += batchSize)
+				{
+					auto n = std::min<u64>(batchSize, hashes.rows() - i);
+					for (u64 j = 0; j < n; ++j)
+						keys[j] = toKey<Key>(hashes[i + j].data(), mMaskSize);
+
+					table.find(span<const Key>(keys.data(), n), [&](u64, Value v) {
+						onHit(mIntersection, v);
+						++mCardinality;
+						});
+				}
+			}
 
-					{
-						block h = oc::ZeroBlock;
-						auto iter = theirHashes.data();
-						for (i = 0; i < mSenderSize; ++i)
-						{
-							memcpy(&h, iter, mMaskSize);
-							iter += mMaskSize;
+			setTimePoint("RsPsiReceiver::run-find");
+		}
+		else
+		{
+			if (ex)
+				mt->oprfProm.set_exception(ex);
+			else
+				mt->oprfProm.set_value();
 
-							auto v = h.get<u32>(0);
-							auto k = libdivide::libdivide_u32_do(v, &divider);
-							v -= k * mNumThreads;
-							if (v == thrdIdx)
-							{
-								auto iter = map.find(h);
-								if (iter != map.end())
-								{
-									intersection[intersectionSize] = iter->second;
-									++intersectionSize;
-								}
-							}
-						}
-					}
+			// The hash intersection consumes the chunks as they arrive.
+			// Sort-merge waits for all of them.
+			try {
+				for (k = 0; k < numChunks && !ex; ++k)
+				{
+					if (!sortMerge)
+						mt->pipe.acquire(k);
 
-					if (!thrdIdx)
-						setTimePoint("RsPsiReceiver::run-find_par");
-					if (intersectionSize)
-					{
-						std::lock_guard<std::mutex> lock(mt->mMergeMtx);
-						mIntersection.insert(mIntersection.end(), intersection, intersection + intersectionSize);
-					}
-				};
+					hashes = chunk(k);
+					co_await(recvHashes(chl, mStripes, hashes, mEncodeHashes, encoded));
 
+					if (!sortMerge)
+						mt->pipe.publish(k);
+				}
+			}
+			catch (...)
+			{
+				ex = std::current_exception();
+			}
 
-			mt->thrds.resize(mt->numThreads);
-			for (i = 0; i < mt->thrds.size(); ++i)
-				mt->thrds[i] = std::thread(mt->routine, i);
-			co_await(chl.recv(theirHashes));
-			mt->prom.set_value();
+			if (ex)
+			{
+				mt->pipe.abort();
+				mt->prom.set_exception(ex);
+			}
+			else
+				mt->prom.set_value();
 
 			for (i = 0; i < mt->thrds.size(); ++i)
 				mt->thrds[i].join();
 
+			if (ex)
+				std::rethrow_exception(ex);
+			if (mt->mEx)
+				std::rethrow_exception(mt->mEx);
+
+			for (i = 0; i < mt->hits.size(); ++i)
+			{
+				mIntersection.insert(mIntersection.end(), mt->hits[i].begin(), mt->hits[i].end());
+				mCardinality += mt->counts[i];
+			}
+
 			setTimePoint("RsPsiReceiver::run-done");
 
 		}
+
+		if (mOutput == PsiOutput::Bitmap)
+		{
+			mIntersectionBitmap.resize(mRecverSize);
+			if (mRecverSize)
+				memcpy(mIntersectionBitmap.data(), bitmap.data(), mIntersectionBitmap.sizeBytes());
+		}
 	}
 
-}
\ No newline at end of file
+}
@@ -9,8 +9,10 @@
 
 #include "volePSI/Defines.h"
 #include "volePSI/RsOprf.h"
-#include "sparsehash/dense_hash_map"
 #include "cryptoTools/Common/Timer.h"
+#include "cryptoTools/Common/BitVector.h"
+#include <bit>
+#include <cstring>
 
 namespace volePSI
 {
@@ -30,6 +32,21 @@ namespace volePSI
             bool mUseReducedRounds = false;
             bool mDebug = false;
 
+            // The sender's hashes are sent in chunks of this many rows.
+            // Must be the same for both parties, run(...) checks this.
+            u64 mHashChunkSize = 1ull << 16;
+
+            // Compress the sender's hashes with HashCodec. They are then
+            // sent as a single chunk, mHashChunkSize is ignored. Saves about
+            // log2(mSenderSize) - 2 bits per hash at the cost of a bucket
+            // sort, but the hashes are no longer evaluated while the
+            // previous chunk is sent. Must be the same for both parties,
+            // run(...) checks this.
+            bool mEncodeHashes = false;
+
+            // Extra sockets that the large messages are striped over, see sendStriped(...).
+            std::vector<Socket> mStripes;
+
             void init(u64 senderSize, u64 recverSize, u64 statSecParam, block seed, bool malicious, u64 numThreads, bool useReducedRounds = false);
 
         };
@@ -47,14 +64,117 @@ namespace volePSI
     };
 
 
+    // How the receiver intersects the truncated hashes.
+    enum class PsiIntersectType
+    {
+        // currently Hash, see RsPsiReceiver::useSortMerge().
+        Auto,
+        // insert the receiver's hashes into a hash table and probe it.
+        Hash,
+        // radix sort both sides and merge join.
+        SortMerge
+    };
+
+    // What the receiver outputs. This only changes the bookkeeping, the
+    // receiver learns the same in every mode.
+    enum class PsiOutput
+    {
+        // the indices of the intersection in mIntersection.
+        Indices,
+        // only the size of the intersection in mCardinality.
+        Cardinality,
+        // bit i of mIntersectionBitmap is set if item i is in the intersection.
+        Bitmap
+    };
+
+    // Iterates over the indices of the set bits of a BitVector, in order.
+    // Only the divCeil(size, 8) bytes of the BitVector are read and the
+    // bits past size() are ignored.
+    class SetBitRange
+    {
+    public:
+        struct Iterator
+        {
+            const SetBitRange* mRange;
+            u64 mIdx, mWord;
+
+            u64 operator*() const { return mIdx * 64 + std::countr_zero(mWord); }
+
+            Iterator& operator++()
+            {
+                mWord &= mWord - 1;
+                while (!mWord && ++mIdx < mRange->mNumWords)
+                    mWord = mRange->word(mIdx);
+                return *this;
+            }
+
+            bool operator==(const Iterator& o) const { return mIdx == o.mIdx && mWord == o.mWord; }
+            bool operator!=(const Iterator& o) const { return !(*this == o); }
+        };
+
+        SetBitRange(const oc::BitVector& bits)
+            : mBytes(bits.data())
+            , mSize(bits.size())
+            , mNumWords(oc::divCeil(bits.size(), 64))
+        {}
+
+        Iterator begin() const
+        {
+            if (!mNumWords)
+                return end();
+            Iterator i{ this, 0, word(0) };
+            if (!i.mWord)
+                ++i;
+            return i;
+        }
+
+        Iterator end() const { return { this, mNumWords, 0 }; }
+
+    private:
+        const u8* mBytes;
+        u64 mSize, mNumWords;
+
+        // word i of the bits, with the bits past mSize cleared.
+        u64 word(u64 i) const
+        {
+            u64 w = 0;
+            auto begin = i * 64;
+            auto bits = std::min<u64>(64, mSize - begin);
+            memcpy(&w, mBytes + i * 8, oc::divCeil(bits, 8));
+            if (bits < 64)
+                w &= (1ull << bits) - 1;
+            return w;
+        }
+    };
+
     class RsPsiReceiver : public details::RsPsiBase, public oc::TimerAdapter
     {
     public:
         RsOprfReceiver mRecver;
+        PsiIntersectType mIntersectType = PsiIntersectType::Auto;
+        PsiOutput mOutput = PsiOutput::Indices;
+
+        // Reuse the OPRF solve of the inputs across calls to run(...) with
+        // the same inputs, see RsOprfReceiver::mReuseSolve.
+        bool mReuseSolve = false;
+
         void setMultType(oc::MultType type) { mRecver.setMultType(type); };
 
         std::vector<u64> mIntersection;
 
+        // The intersection as a bitmap over the receiver's items, see PsiOutput::Bitmap.
+        oc::BitVector mIntersectionBitmap;
+
+        // The size of the intersection. Set for every output mode.
+        u64 mCardinality = 0;
+
         Proto run(span<block> inputs, Socket& chl);
+
+    private:
+
+        bool useSortMerge() const;
+
+        template<typename Key, typename Value>
+        Proto runImpl(span<block> inputs, Socket& chl);
     };
 }
\ No newline at end of file
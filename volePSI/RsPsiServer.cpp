@@ -0,0 +1,86 @@
+#include "RsPsiServer.h"
+#include "macoro/sync_wait.h"
+#include <atomic>
+#include <thread>
+
+namespace volePSI
+{
+	void RsPsiServer::init(
+		std::vector<block> inputs,
+		u64 statSecParam,
+		block seed,
+		bool malicious,
+		u64 numThreads,
+		u64 maxSessions,
+		bool useReducedRounds)
+	{
+		mInputs = std::move(inputs);
+		mSsp = statSecParam;
+		mPrng.SetSeed(seed);
+		mMalicious = malicious;
+		mNumThreads = std::max<u64>(1, numThreads);
+		mMaxSessions = std::max<u64>(1, maxSessions);
+		mUseReducedRounds = useReducedRounds;
+	}
+
+	Proto RsPsiServer::serve(Socket& chl, block seed, u64 numThreads)
+	{
+		auto sender = RsPsiSender{};
+		auto theirSize = u64{};
+		auto mySize = u64{ mInputs.size() };
+
+		co_await(chl.send(std::move(mySize)));
+		co_await(chl.recv(theirSize));
+
+		if (theirSize > mMaxRecverSize)
+		{
+			co_await(chl.close());
+			throw std::runtime_error("RsPsiServer: the receiver's set size " + std::to_string(theirSize) +
+				" is larger than mMaxRecverSize = " + std::to_string(mMaxRecverSize) + ". " LOCATION);
+		}
+
+		sender.setMultType(mMultType);
+		sender.init(mInputs.size(), theirSize, mSsp, seed, mMalicious, numThreads, mUseReducedRounds);
+		co_await(sender.run(mInputs, chl));
+	}
+
+	void RsPsiServer::run(span<Socket> chls)
+	{
+		auto seeds = std::vector<block>{};
+		auto next = std::atomic<u64>{ 0 };
+
+		setTimePoint("RsPsiServer::run-begin");
+
+		seeds.resize(chls.size());
+		mPrng.get(seeds.data(), seeds.size());
+		mSessionErrors.clear();
+		mSessionErrors.resize(chls.size());
+
+		// each worker serves the next session that has not started, so a
+		// slow session only holds up its own worker.
+		auto routine = [&]() {
+			for (auto i = next++; i < chls.size(); i = next++)
+			{
+				try {
+					macoro::sync_wait(serve(chls[i], seeds[i], mNumThreads));
+				}
+				catch (...)
+				{
+					mSessionErrors[i] = std::current_exception();
+				}
+			}
+		};
+
+		auto numWorkers = std::max<u64>(1, std::min<u64>(mMaxSessions, chls.size()));
+		std::vector<std::thread> thrds(numWorkers - 1);
+		for (auto& t : thrds)
+			t = std::thread(routine);
+
+		routine();
+
+		for (auto& t : thrds)
+			t.join();
+
+		setTimePoint("RsPsiServer::run-end");
+	}
+}
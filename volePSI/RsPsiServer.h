@@ -0,0 +1,58 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include "volePSI/RsPsi.h"
+#include "cryptoTools/Common/Timer.h"
+
+namespace volePSI
+{
+    // A PSI sender that serves many receivers with one input set. The set
+    // is stored once and shared by all sessions. Each session is a normal 
+    // RsPsiSender session, preceded by an exchange of the set sizes as done 
+    // by doFilePSI. The sessions run concurrently on mMaxSessions worker
+    // threads, each worker starting the next session when its current one
+    // is done. Each session uses mNumThreads threads. Since the sender 
+    // sends its hashes in chunks, the memory of a session is dominated by
+    // the OPRF state for the receiver's set.
+    class RsPsiServer : public oc::TimerAdapter
+    {
+    public:
+        std::vector<block> mInputs;
+        u64 mSsp = 0;
+        PRNG mPrng;
+        bool mMalicious = false;
+        u64 mNumThreads = 0;
+        u64 mMaxSessions = 0;
+        bool mUseReducedRounds = false;
+        oc::MultType mMultType = oc::DefaultMultType;
+
+        // The largest receiver set that is accepted. This bounds the memory
+        // a single receiver can make its session allocate. Larger receivers
+        // are rejected and their socket is closed.
+        u64 mMaxRecverSize = 1ull << 24;
+
+        // The error of each session of the last run(...), if any.
+        std::vector<std::exception_ptr> mSessionErrors;
+
+        void init(std::vector<block> inputs, u64 statSecParam, block seed, bool malicious, u64 numThreads, u64 maxSessions, bool useReducedRounds = false);
+
+        void setMultType(oc::MultType type) { mMultType = type; };
+
+        // runs one session over chl with numThreads threads.
+        Proto serve(Socket& chl, block seed, u64 numThreads);
+
+        // serves every socket in chls and blocks until all sessions are
+        // done. The sessions are driven by the worker threads, so the
+        // sockets must not depend on the calling thread to make progress.
+        // A failed session does not stop the others, its error is stored
+        // in mSessionErrors.
+        void run(span<Socket> chls);
+    };
+}
@@ -0,0 +1,234 @@
+#include "ShardedPsi.h"
+#include "macoro/sync_wait.h"
+#include <cmath>
+#include <thread>
+
+namespace volePSI
+{
+
+	void details::ShardedPsiBase::init(
+		u64 senderSize,
+		u64 recverSize,
+		u64 numShards,
+		u64 statSecParam,
+		block seed,
+		bool malicious,
+		u64 numThreads,
+		bool useReducedRounds)
+	{
+		if (numShards == 0)
+			throw std::runtime_error("ShardedPsi: numShards must be positive. " LOCATION);
+
+		mSenderSize = senderSize;
+		mRecverSize = recverSize;
+		mNumShards = numShards;
+		mSsp = statSecParam;
+		mPrng.SetSeed(seed);
+		mMalicious = malicious;
+		mNumThreads = numThreads;
+		mUseReducedRounds = useReducedRounds;
+
+		mShardSenderSize = shardBound(mSenderSize, mNumShards, mSsp);
+		mShardRecverSize = shardBound(mRecverSize, mNumShards, mSsp);
+
+		mShardSeeds.resize(mNumShards);
+		mPrng.get(mShardSeeds.data(), mShardSeeds.size());
+
+		// a fixed public key so that both parties agree on the shards.
+		mShardHash.setKey(block(0x7368617264696e67ull, 0x5073695368617264ull));
+
+		mShards.clear();
+		mShardIdxs.clear();
+	}
+
+	u64 details::ShardedPsiBase::shardOf(const block& x) const
+	{
+		return mShardHash.hashBlock(x).get<u64>(0) % mNumShards;
+	}
+
+	u64 details::ShardedPsiBase::shardBound(u64 n, u64 numShards, u64 ssp)
+	{
+		if (numShards == 1)
+			return n;
+
+		// Bernstein's inequality with a union bound over the shards. A shard
+		// has more than mu + t items with probability at most 
+		// exp(-t^2 / (2(mu + t/3))) <= 2^-ssp / numShards.
+		auto mu = double(n) / numShards;
+		auto l = (ssp + oc::log2ceil(numShards)) * std::log(2.0);
+		auto t = l / 3 + std::sqrt(l * l / 9 + 2 * l * mu);
+		return std::min<u64>(n, static_cast<u64>(std::ceil(mu + t)));
+	}
+
+	void details::ShardedPsiBase::partition(span<const block> inputs, u64 shardSize)
+	{
+		mShards.assign(mNumShards, {});
+		mShardIdxs.assign(mNumShards, {});
+		for (u64 s = 0; s < mNumShards; ++s)
+		{
+			mShards[s].reserve(shardSize);
+			mShardIdxs[s].reserve(shardSize);
+		}
+
+		for (u64 i = 0; i < inputs.size(); ++i)
+		{
+			auto s = shardOf(inputs[i]);
+			mShards[s].push_back(inputs[i]);
+			mShardIdxs[s].push_back(i);
+		}
+
+		for (u64 s = 0; s < mNumShards; ++s)
+		{
+			if (mShards[s].size() > shardSize)
+				throw std::runtime_error("ShardedPsi: a shard is larger than the padded shard size. " LOCATION);
+
+			// random dummies, they collide with another item 
+			// with negligible probability.
+			auto n = mShards[s].size();
+			mShards[s].resize(shardSize);
+			mPrng.get(mShards[s].data() + n, shardSize - n);
+		}
+	}
+
+	namespace
+	{
+		// Each shard is an independent session whose false positive rate
+		// is bounded by 2^-ssp. The extra log2(mNumShards) bits pay for the
+		// union bound over the mNumShards sessions. The shards together
+		// make about mNumShards times fewer comparisons than one session.
+		u64 shardSsp(u64 ssp, u64 numShards)
+		{
+			return ssp + oc::log2ceil(numShards);
+		}
+
+		// the threads of each shard when run(...) splits numThreads between them.
+		u64 shardThreads(u64 numThreads, u64 numShards)
+		{
+			return std::max<u64>(1, numThreads / numShards);
+		}
+
+		// runs shard(i) for every shard, each on its own thread, and waits
+		// for all of them, even if one fails. The first error is rethrown.
+		template<typename Fn>
+		void runShards(u64 numShards, Fn&& shard)
+		{
+			std::vector<std::exception_ptr> errors(numShards);
+			auto routine = [&](u64 i) {
+				try {
+					macoro::sync_wait(shard(i));
+				}
+				catch (...)
+				{
+					errors[i] = std::current_exception();
+				}
+			};
+
+			std::vector<std::thread> thrds(numShards - 1);
+			for (u64 i = 1; i < numShards; ++i)
+				thrds[i - 1] = std::thread(routine, i);
+
+			routine(0);
+
+			for (auto& t : thrds)
+				t.join();
+
+			for (auto& e : errors)
+				if (e)
+					std::rethrow_exception(e);
+		}
+	}
+
+	void ShardedPsiSender::setInputs(span<const block> inputs)
+	{
+		if (inputs.size() != mSenderSize)
+			throw RTE_LOC;
+
+		partition(inputs, mShardSenderSize);
+		setTimePoint("ShardedPsiSender::setInputs");
+	}
+
+	Proto ShardedPsiSender::runShard(u64 shardIdx, Socket& chl, u64 numThreads)
+	{
+		auto sender = RsPsiSender{};
+
+		if (shardIdx >= mShards.size())
+			throw std::runtime_error("ShardedPsiSender::setInputs(...) must be called before runShard(...). " LOCATION);
+
+		sender.init(mShardSenderSize, mShardRecverSize, shardSsp(mSsp, mNumShards), 
+			mShardSeeds[shardIdx], mMalicious, numThreads ? numThreads : mNumThreads, mUseReducedRounds);
+		co_await(sender.run(mShards[shardIdx], chl));
+	}
+
+	void ShardedPsiSender::run(span<const block> inputs, span<Socket> chls)
+	{
+		if (chls.size() != mNumShards)
+			throw RTE_LOC;
+
+		setInputs(inputs);
+
+		auto numThreads = shardThreads(mNumThreads, mNumShards);
+		runShards(mNumShards, [&](u64 i) { return runShard(i, chls[i], numThreads); });
+
+		setTimePoint("ShardedPsiSender::run-done");
+	}
+
+	void ShardedPsiReceiver::setInputs(span<const block> inputs)
+	{
+		if (inputs.size() != mRecverSize)
+			throw RTE_LOC;
+
+		partition(inputs, mShardRecverSize);
+		mShardIntersection.clear();
+		mShardIntersection.resize(mNumShards);
+		setTimePoint("ShardedPsiReceiver::setInputs");
+	}
+
+	Proto ShardedPsiReceiver::runShard(u64 shardIdx, Socket& chl, u64 numThreads)
+	{
+		auto recver = RsPsiReceiver{};
+
+		if (shardIdx >= mShards.size())
+			throw std::runtime_error("ShardedPsiReceiver::setInputs(...) must be called before runShard(...). " LOCATION);
+
+		recver.init(mShardSenderSize, mShardRecverSize, shardSsp(mSsp, mNumShards),
+			mShardSeeds[shardIdx], mMalicious, numThreads ? numThreads : mNumThreads, mUseReducedRounds);
+		co_await(recver.run(mShards[shardIdx], chl));
+
+		// map back to the original indices and drop the dummies.
+		{
+			auto& idxs = mShardIdxs[shardIdx];
+			auto& out = mShardIntersection[shardIdx];
+			out.clear();
+			out.reserve(recver.mIntersection.size());
+			for (auto j : recver.mIntersection)
+				if (j < idxs.size())
+					out.push_back(idxs[j]);
+		}
+	}
+
+	void ShardedPsiReceiver::run(span<const block> inputs, span<Socket> chls)
+	{
+		if (chls.size() != mNumShards)
+			throw RTE_LOC;
+
+		setInputs(inputs);
+
+		auto numThreads = shardThreads(mNumThreads, mNumShards);
+		runShards(mNumShards, [&](u64 i) { return runShard(i, chls[i], numThreads); });
+
+		mergeIntersection();
+		setTimePoint("ShardedPsiReceiver::run-done");
+	}
+
+	void ShardedPsiReceiver::mergeIntersection()
+	{
+		u64 size = 0;
+		for (auto& s : mShardIntersection)
+			size += s.size();
+
+		mIntersection.clear();
+		mIntersection.reserve(size);
+		for (auto& s : mShardIntersection)
+			mIntersection.insert(mIntersection.end(), s.begin(), s.end());
+	}
+}
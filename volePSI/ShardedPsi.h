@@ -0,0 +1,116 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include "volePSI/RsPsi.h"
+#include "cryptoTools/Common/Timer.h"
+#include "cryptoTools/Crypto/AES.h"
+
+namespace volePSI
+{
+    namespace details
+    {
+        struct ShardedPsiBase
+        {
+            u64 mSenderSize = 0;
+            u64 mRecverSize = 0;
+            u64 mNumShards = 0;
+            u64 mSsp = 0;
+            PRNG mPrng;
+            bool mMalicious = false;
+            u64 mNumThreads = 0;
+            bool mUseReducedRounds = false;
+
+            // The public size that every sender/receiver shard is padded to.
+            u64 mShardSenderSize = 0;
+            u64 mShardRecverSize = 0;
+
+            // The padded inputs of each shard and the original index 
+            // of each real item in them.
+            std::vector<std::vector<block>> mShards;
+            std::vector<std::vector<u64>> mShardIdxs;
+
+            // The seed of each shard's session.
+            std::vector<block> mShardSeeds;
+
+            // The public hash that assigns items to shards.
+            oc::AES mShardHash;
+
+            void init(u64 senderSize, u64 recverSize, u64 numShards, u64 statSecParam, block seed, bool malicious, u64 numThreads, bool useReducedRounds);
+
+            // returns the shard of x.
+            u64 shardOf(const block& x) const;
+
+            // An upper bound on the size of a shard of a random set of size n
+            // that fails with probability at most 2^-ssp.
+            static u64 shardBound(u64 n, u64 numShards, u64 ssp);
+
+            // splits the inputs into the shards and pads each with random dummies.
+            void partition(span<const block> inputs, u64 shardSize);
+        };
+    }
+
+    // PSI that splits both sets into mNumShards shards by a hash of
+    // each item and runs an independent RsPsi session per shard. Each 
+    // shard is padded to a public size so the shard sizes leak nothing.
+    // The sessions can use different sockets, or even machines, by 
+    // calling setInputs(...) on each and runShard(...) for its shards.
+    class ShardedPsiSender : public details::ShardedPsiBase, public oc::TimerAdapter
+    {
+    public:
+
+        void init(u64 senderSize, u64 recverSize, u64 numShards, u64 statSecParam, block seed, bool malicious, u64 numThreads = 1, bool useReducedRounds = false)
+        {
+            details::ShardedPsiBase::init(senderSize, recverSize, numShards, statSecParam, seed, malicious, numThreads, useReducedRounds);
+        }
+
+        void setInputs(span<const block> inputs);
+
+        // runs shard shardIdx over chl with numThreads threads, or
+        // mNumThreads if zero.
+        Proto runShard(u64 shardIdx, Socket& chl, u64 numThreads = 0);
+
+        // runs all shards in parallel, shard i over chls[i] on its own
+        // thread, and blocks until they are done. The shards split the
+        // mNumThreads threads. The sockets must not depend on the calling
+        // thread to make progress.
+        void run(span<const block> inputs, span<Socket> chls);
+    };
+
+    class ShardedPsiReceiver : public details::ShardedPsiBase, public oc::TimerAdapter
+    {
+    public:
+
+        // The intersection of each shard, as indices into the original inputs.
+        std::vector<std::vector<u64>> mShardIntersection;
+
+        // The merged intersection. Set by run(...) or mergeIntersection().
+        std::vector<u64> mIntersection;
+
+        void init(u64 senderSize, u64 recverSize, u64 numShards, u64 statSecParam, block seed, bool malicious, u64 numThreads = 1, bool useReducedRounds = false)
+        {
+            details::ShardedPsiBase::init(senderSize, recverSize, numShards, statSecParam, seed, malicious, numThreads, useReducedRounds);
+        }
+
+        void setInputs(span<const block> inputs);
+
+        // runs shard shardIdx over chl with numThreads threads, or
+        // mNumThreads if zero.
+        Proto runShard(u64 shardIdx, Socket& chl, u64 numThreads = 0);
+
+        // runs all shards in parallel, shard i over chls[i] on its own
+        // thread, and blocks until they are done. The shards split the
+        // mNumThreads threads. The sockets must not depend on the calling
+        // thread to make progress.
+        void run(span<const block> inputs, span<Socket> chls);
+
+        // merges mShardIntersection into mIntersection.
+        void mergeIntersection();
+    };
+}
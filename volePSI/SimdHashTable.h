@@ -0,0 +1,243 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "volePSI/Defines.h"
+#include <memory>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+namespace volePSI
+{
+	// An insert-only open addressing hash table for the truncated OPRF
+	// outputs of the PSI receiver. The slots are split into groups of 16.
+	// Each slot has a one byte control word which is either empty (0x80)
+	// or a 7 bit tag of the key. A probe compares the tag against the
+	// whole group with one SIMD compare and only then looks at the keys.
+	//
+	// Key is u64 or block and Value an unsigned integer type. Duplicate
+	// keys are not detected, find(...) returns the first one inserted.
+	template<typename Key, typename Value>
+	class SimdHashTable
+	{
+	public:
+		static constexpr u64 sGroupSize = 16;
+		static constexpr u8 sEmpty = 0x80;
+		static constexpr Value npos = ~Value(0);
+
+		// the number of keys that are hashed and prefetched at a time by
+		// the batched insert and find.
+		static constexpr u64 sBatchSize = 16;
+
+		// reserve space for capacity items. The load factor is kept at
+		// most 7/8 so that a probe sequence always ends.
+		void init(u64 capacity)
+		{
+			auto minGroups = oc::divCeil(oc::divCeil(capacity * 8, 7), sGroupSize);
+			mLogNumGroups = std::max<u64>(1, oc::log2ceil(std::max<u64>(minGroups, 1)));
+			mGroupMask = (1ull << mLogNumGroups) - 1;
+
+			auto numSlots = (mGroupMask + 1) * sGroupSize;
+			mCtrl.reset(new u8[numSlots]);
+			mKeys.reset(new Key[numSlots]);
+			mValues.reset(new Value[numSlots]);
+			std::memset(mCtrl.get(), sEmpty, numSlots);
+
+			mCapacity = capacity;
+			mSize = 0;
+		}
+
+		u64 size() const { return mSize; }
+
+		u64 capacity() const { return mCapacity; }
+
+		void insert(const Key& key, Value value)
+		{
+			insertImpl(hash(key), key, value);
+		}
+
+		// insert keys[i] -> values[i].
+		void insert(span<const Key> keys, span<const Value> values)
+		{
+			assert(keys.size() == values.size());
+			std::array<u64, sBatchSize> h;
+			u64 i = 0;
+			for (; i + sBatchSize <= keys.size(); i += sBatchSize)
+			{
+				for (u64 j = 0; j < sBatchSize; ++j)
+				{
+					h[j] = hash(keys[i + j]);
+					prefetchAddr(&mCtrl[groupIdx(h[j]) * sGroupSize]);
+				}
+				for (u64 j = 0; j < sBatchSize; ++j)
+					insertImpl(h[j], keys[i + j], values[i + j]);
+			}
+			for (; i < keys.size(); ++i)
+				insert(keys[i], values[i]);
+		}
+
+		// prefetch the group that a find(key) will start at.
+		void prefetch(const Key& key) const
+		{
+			auto g = groupIdx(hash(key)) * sGroupSize;
+			prefetchAddr(&mCtrl[g]);
+			prefetchAddr(&mKeys[g]);
+		}
+
+		// returns the value of key or npos.
+		Value find(const Key& key) const
+		{
+			return findImpl(hash(key), key);
+		}
+
+		// calls onHit(i, value) for every keys[i] that is in the table.
+		template<typename Fn>
+		void find(span<const Key> keys, Fn&& onHit) const
+		{
+			std::array<u64, sBatchSize> h;
+			u64 i = 0;
+			for (; i + sBatchSize <= keys.size(); i += sBatchSize)
+			{
+				for (u64 j = 0; j < sBatchSize; ++j)
+				{
+					h[j] = hash(keys[i + j]);
+					auto g = groupIdx(h[j]) * sGroupSize;
+					prefetchAddr(&mCtrl[g]);
+					prefetchAddr(&mKeys[g]);
+				}
+
+				for (u64 j = 0; j < sBatchSize; ++j)
+				{
+					auto v = findImpl(h[j], keys[i + j]);
+					if (v != npos)
+						onHit(i + j, v);
+				}
+			}
+
+			for (; i < keys.size(); ++i)
+			{
+				auto v = find(keys[i]);
+				if (v != npos)
+					onHit(i, v);
+			}
+		}
+
+	private:
+
+		std::unique_ptr<u8[]> mCtrl;
+		std::unique_ptr<Key[]> mKeys;
+		std::unique_ptr<Value[]> mValues;
+		u64 mLogNumGroups = 0, mGroupMask = 0;
+		u64 mCapacity = 0, mSize = 0;
+
+		static u64 hash(const u64& k)
+		{
+			return k * 0x9E3779B97F4A7C15ull;
+		}
+
+		static u64 hash(const block& k)
+		{
+			return (k.get<u64>(0) ^ k.get<u64>(1)) * 0x9E3779B97F4A7C15ull;
+		}
+
+		// the top bits of the hash select the group...
+		u64 groupIdx(u64 h) const
+		{
+			return h >> (64 - mLogNumGroups);
+		}
+
+		// and the next 7 bits are the tag.
+		u8 tag(u64 h) const
+		{
+			return (h >> (64 - mLogNumGroups - 7)) & 0x7F;
+		}
+
+		static void prefetchAddr(const void* ptr)
+		{
+#ifdef ENABLE_SSE
+			_mm_prefetch((const char*)ptr, _MM_HINT_T0);
+#else
+			(void)ptr;
+#endif
+		}
+
+		// returns a bit mask of the slots in the group with the given tag.
+		static u32 matchTag(const u8* ctrl, u8 t)
+		{
+#ifdef ENABLE_SSE
+			auto c = _mm_loadu_si128((const __m128i*)ctrl);
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(t)));
+#else
+			u32 r = 0;
+			for (u64 i = 0; i < sGroupSize; ++i)
+				r |= u32(ctrl[i] == t) << i;
+			return r;
+#endif
+		}
+
+		// returns a bit mask of the empty slots in the group.
+		static u32 matchEmpty(const u8* ctrl)
+		{
+#ifdef ENABLE_SSE
+			return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+			u32 r = 0;
+			for (u64 i = 0; i < sGroupSize; ++i)
+				r |= u32(ctrl[i] >> 7) << i;
+			return r;
+#endif
+		}
+
+		void insertImpl(u64 h, const Key& key, Value value)
+		{
+			if (mSize == mCapacity)
+				throw std::runtime_error("SimdHashTable is full. " LOCATION);
+
+			auto g = groupIdx(h);
+			while (true)
+			{
+				auto ctrl = &mCtrl[g * sGroupSize];
+				auto e = matchEmpty(ctrl);
+				if (e)
+				{
+					auto s = g * sGroupSize + std::countr_zero(e);
+					mCtrl[s] = tag(h);
+					mKeys[s] = key;
+					mValues[s] = value;
+					++mSize;
+					return;
+				}
+				g = (g + 1) & mGroupMask;
+			}
+		}
+
+		Value findImpl(u64 h, const Key& key) const
+		{
+			auto g = groupIdx(h);
+			auto t = tag(h);
+			while (true)
+			{
+				auto ctrl = &mCtrl[g * sGroupSize];
+				auto m = matchTag(ctrl, t);
+				while (m)
+				{
+					auto s = g * sGroupSize + std::countr_zero(m);
+					if (mKeys[s] == key)
+						return mValues[s];
+					m &= m - 1;
+				}
+
+				if (matchEmpty(ctrl))
+					return npos;
+
+				g = (g + 1) & mGroupMask;
+			}
+		}
+	};
+}
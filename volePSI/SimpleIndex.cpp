@@ -5,6 +5,8 @@
 #include "cryptoTools/Common/Log.h"
 #include "cryptoTools/Common/CuckooIndex.h"
 #include <cassert>
+#include <atomic>
+#include <thread>
 
 #ifdef ENABLE_BOOST
 #include <boost/math/special_functions/binomial.hpp>
@@ -318,14 +320,30 @@ namespace volePSI
     {
         mNumHashFunctions = numHashFunction;
         mMaxBinSize = get_bin_size(numBins, numBalls * numHashFunction, statSecParam);
-        mBins.resize(numBins, mMaxBinSize);
-        mBinSizes.resize(numBins, 0);
-        mItemToBinMap.resize(numBalls, numHashFunction);
         mNumBins = numBins;
+
+        // the bins are allocated by setBinRange or the first insertItems.
+        mBins.resize(0, 0);
+        mBinSizes.clear();
+        mBinBegin = 0;
+    }
+
+    void SimpleIndex::setBinRange(u64 begin, u64 end)
+    {
+        if (begin > end || end > mNumBins)
+            throw RTE_LOC;
+
+        mBinBegin = begin;
+        mBins.resize(0, 0);
+        mBins.resize(end - begin, mMaxBinSize);
+        mBinSizes.assign(end - begin, 0);
     }
 
-    void SimpleIndex::insertItems(span<block> items, block hashingSeed)
+    void SimpleIndex::insertItems(span<block> items, block hashingSeed, u64 numThreads)
     {
+        if (mBinSizes.empty())
+            setBinRange(0, mNumBins);
+
         oc::CuckooIndex<> cuckoo;
 
         {
@@ -346,25 +364,52 @@ namespace volePSI
 
         // cuckoo.computeLocations()
 
-        oc::Matrix<u32> locations(32, mNumHashFunctions);
-        std::array<block, 32> hashs;
-        oc::AES hasher(hashingSeed);
-        for (u64 i = 0; i < items.size(); i += hashs.size())
+        numThreads = std::max<u64>(1, std::min<u64>(numThreads, oc::divCeil(items.size(), 1 << 12)));
+
+        // inserts items [begin, end). The threads share the bins, so the
+        // position in a bin is taken with an atomic add.
+        auto routine = [&](u64 begin, u64 end)
         {
-            auto min = std::min<u64>(items.size() - i, hashs.size());
-            hasher.hashBlocks(items.data() + i, min, hashs.data());
+            oc::Matrix<u32> locations(32, mNumHashFunctions);
+            std::array<block, 32> hashs;
+            oc::AES hasher(hashingSeed);
+            for (u64 i = begin; i < end; i += hashs.size())
+            {
+                auto min = std::min<u64>(end - i, hashs.size());
+                hasher.hashBlocks(items.data() + i, min, hashs.data());
 
-            cuckoo.computeLocations(hashs, locations);
+                cuckoo.computeLocations(hashs, locations);
 
-            for (u64 j = 0; j < mNumHashFunctions; ++j)
-            {
-                for(u64 k = 0; k < min; ++k)
+                for (u64 j = 0; j < mNumHashFunctions; ++j)
                 {
-                    auto loc = locations(k,j);
-                    mBins(loc, mBinSizes[loc]++).set(i+k, j);
+                    for (u64 k = 0; k < min; ++k)
+                    {
+                        // only the bins in [mBinBegin, mBinBegin + mBinSizes.size()) are kept.
+                        auto loc = locations(k, j) - mBinBegin;
+                        if (loc >= mBinSizes.size())
+                            continue;
+
+                        auto pos = numThreads > 1 ?
+                            std::atomic_ref<u64>(mBinSizes[loc]).fetch_add(1, std::memory_order_relaxed) :
+                            mBinSizes[loc]++;
+                        mBins(loc, pos).set(i + k, j);
+                    }
                 }
             }
-        }
+        };
+
+        // the ranges are multiples of the batch size.
+        auto numBatches = oc::divCeil(items.size(), 32);
+        auto rangeBegin = [&](u64 t) { return std::min<u64>(items.size(), t * numBatches / numThreads * 32); };
+
+        std::vector<std::thread> thrds(numThreads - 1);
+        for (u64 t = 1; t < numThreads; ++t)
+            thrds[t - 1] = std::thread(routine, rangeBegin(t), rangeBegin(t + 1));
+
+        routine(rangeBegin(0), rangeBegin(1));
+
+        for (auto& t : thrds)
+            t.join();
     }
 
 }
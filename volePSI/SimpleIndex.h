@@ -65,20 +65,28 @@ namespace volePSI
         Matrix<Item> mBins;
         u64 mNumBins;
 
-        // numBalls x mNumHashFunctions matrix, (i,j) contains the i'th items
-        // hash value under hash index j.
-        Matrix<u64> mItemToBinMap;
-
         // The some of each bin.
         std::vector<u64> mBinSizes;
 
+        // The bin of the first row of mBins, see setBinRange.
+        u64 mBinBegin = 0;
+
         block mHashSeed;
         void print() ;
         static  u64 get_bin_size(u64 numBins, u64 numBalls, u64 statSecParam, bool approx = true);
         
 
         void init(u64 numBins, u64 numBalls, u64 statSecParam = 40, u64 numHashFunction = 3);
-        void insertItems(span<block> items, block hashingSeed);
+
+        // Only keep the bins [begin, end) in mBins and mBinSizes and clear
+        // them. The items inserted after this are only placed in these bins.
+        // Otherwise all the bins are allocated by the first insertItems.
+        void setBinRange(u64 begin, u64 end);
+
+        // Insert the items into their bins under each hash function. With
+        // numThreads > 1 the items are split between the threads and the
+        // order of the items within a bin is not deterministic.
+        void insertItems(span<block> items, block hashingSeed, u64 numThreads = 1);
     };
 
 }
@@ -0,0 +1,67 @@
+#include "StripedSocket.h"
+
+namespace volePSI
+{
+	namespace
+	{
+		Proto sendPart(Socket& chl, span<u8> data)
+		{
+			co_await(chl.send(std::move(data)));
+		}
+
+		Proto recvPart(Socket& chl, span<u8> data)
+		{
+			co_await(chl.recv(data));
+		}
+
+		// sends or receives the parts of data concurrently.
+		Proto stripe(Socket& chl, span<Socket> stripes, span<u8> data, bool send)
+		{
+			auto tasks = std::vector<macoro::eager_task<void>>{};
+			auto ex = std::exception_ptr{};
+			auto numParts = u64{};
+			auto i = u64{};
+
+			numParts = data.size() < StripeMinSize ? 1 : stripes.size() + 1;
+			tasks.reserve(numParts);
+			for (i = 0; i < numParts; ++i)
+			{
+				auto begin = i * data.size() / numParts;
+				auto end = (i + 1) * data.size() / numParts;
+				auto& sock = i ? stripes[i - 1] : chl;
+				auto part = data.subspan(begin, end - begin);
+
+				if (send)
+					tasks.push_back(sendPart(sock, part) | macoro::make_eager());
+				else
+					tasks.push_back(recvPart(sock, part) | macoro::make_eager());
+			}
+
+			// wait for every part, even if one fails.
+			for (i = 0; i < numParts; ++i)
+			{
+				try {
+					co_await(tasks[i]);
+				}
+				catch (...)
+				{
+					if (!ex)
+						ex = std::current_exception();
+				}
+			}
+
+			if (ex)
+				std::rethrow_exception(ex);
+		}
+	}
+
+	Proto sendStriped(Socket& chl, span<Socket> stripes, span<u8> data)
+	{
+		return stripe(chl, stripes, data, true);
+	}
+
+	Proto recvStriped(Socket& chl, span<Socket> stripes, span<u8> data)
+	{
+		return stripe(chl, stripes, data, false);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "volePSI/Defines.h"
+#include <vector>
+
+namespace volePSI
+{
+	// Messages smaller than this are never striped.
+	constexpr u64 StripeMinSize = 1 << 16;
+
+	// Sends a large message over chl and the extra sockets in stripes. The
+	// message is split into stripes.size() + 1 contiguous parts that are 
+	// sent concurrently, part 0 over chl and part i over stripes[i-1]. 
+	// This lets a long fat pipe be filled by several connections. Each 
+	// socket is its own ordered stream so the parts are reassembled by
+	// the receiver calling recvStriped(...) with the same size and the
+	// same number of stripes. Without stripes this is chl.send(data).
+	Proto sendStriped(Socket& chl, span<Socket> stripes, span<u8> data);
+
+	Proto recvStriped(Socket& chl, span<Socket> stripes, span<u8> data);
+
+	template<typename T>
+	Proto sendStriped(Socket& chl, span<Socket> stripes, span<T> data)
+	{
+		return sendStriped(chl, stripes, span<u8>((u8*)data.data(), data.size_bytes()));
+	}
+
+	template<typename T>
+	Proto recvStriped(Socket& chl, span<Socket> stripes, span<T> data)
+	{
+		return recvStriped(chl, stripes, span<u8>((u8*)data.data(), data.size_bytes()));
+	}
+}
@@ -0,0 +1,458 @@
+#include "UbPsi.h"
+
+#ifdef ENABLE_SODIUM
+#include "cryptoTools/Crypto/RandomOracle.h"
+#include <thread>
+#include <algorithm>
+
+namespace volePSI
+{
+	namespace
+	{
+		using Point = details::UbPsiBase::Point;
+		using Number = details::UbPsiBase::Number;
+
+		// H'(x), hash x onto the curve.
+		Point hashToPoint(const block& x)
+		{
+			std::array<u8, Point::fromHashLength> buff;
+			oc::RandomOracle ro(buff.size());
+			ro.Update(x);
+			ro.Final(buff);
+			return Point::fromHash(buff.data());
+		}
+
+		// The OPRF output H(x, k * H'(x)) truncated to maskSize bytes.
+		void hashOutput(const block& x, const Point& p, u8* dest, u64 maskSize)
+		{
+			std::array<u8, Point::size> buff;
+			block h;
+			p.toBytes(buff.data());
+			oc::RandomOracle ro(sizeof(block));
+			ro.Update(x);
+			ro.Update(buff.data(), buff.size());
+			ro.Final(h);
+			memcpy(dest, &h, maskSize);
+		}
+
+		// calls fn(begin, end) for numThreads disjoint sub-ranges of [0, n).
+		template<typename Fn>
+		void parallelFor(u64 n, u64 numThreads, Fn&& fn)
+		{
+			numThreads = std::max<u64>(1, std::min<u64>(numThreads, n));
+			std::vector<std::thread> thrds(numThreads - 1);
+			for (u64 i = 1; i < numThreads; ++i)
+				thrds[i - 1] = std::thread([&, i]() {
+					fn(i * n / numThreads, (i + 1) * n / numThreads);
+				});
+
+			fn(0, n / numThreads);
+
+			for (auto& t : thrds)
+				t.join();
+		}
+
+		bool contains(const Matrix<u8>& table, const u8* h, u64 maskSize)
+		{
+			u64 begin = 0, end = table.rows();
+			while (begin < end)
+			{
+				auto mid = (begin + end) / 2;
+				if (memcmp(table[mid].data(), h, maskSize) < 0)
+					begin = mid + 1;
+				else
+					end = mid;
+			}
+
+			return begin != table.rows() &&
+				memcmp(table[begin].data(), h, maskSize) == 0;
+		}
+
+		bool itemLess(const block& a, const block& b)
+		{
+			return memcmp(&a, &b, sizeof(block)) < 0;
+		}
+
+		// The sorted truncated OPRF outputs of inputs under key.
+		Matrix<u8> sortedTable(span<const block> inputs, const Number& key, u64 maskSize, u64 numThreads)
+		{
+			std::vector<block> hashes(inputs.size(), oc::ZeroBlock);
+			parallelFor(inputs.size(), numThreads, [&](u64 begin, u64 end) {
+				for (u64 i = begin; i < end; ++i)
+				{
+					auto p = hashToPoint(inputs[i]) * key;
+					hashOutput(inputs[i], p, (u8*)&hashes[i], maskSize);
+				}
+			});
+
+			// sort the truncated outputs so that the client can binary search them
+			// and learns nothing from the order.
+			std::sort(hashes.begin(), hashes.end(), [maskSize](const block& a, const block& b) {
+				return memcmp(&a, &b, maskSize) < 0;
+			});
+
+			Matrix<u8> table(hashes.size(), maskSize, oc::AllocType::Uninitialized);
+			for (u64 i = 0; i < hashes.size(); ++i)
+				memcpy(table[i].data(), &hashes[i], maskSize);
+			return table;
+		}
+
+		// Returns table with the rows of removed taken out and the rows of
+		// added merged in. All three are sorted and so is the result.
+		Matrix<u8> applyDelta(const Matrix<u8>& table, const Matrix<u8>& added, const Matrix<u8>& removed, u64 maskSize)
+		{
+			if (removed.rows() > table.rows())
+				throw std::runtime_error("UbPsi: a removed item is not in the table. " LOCATION);
+
+			Matrix<u8> r(table.rows() + added.rows() - removed.rows(), maskSize, oc::AllocType::Uninitialized);
+			u64 i = 0, j = 0, k = 0, o = 0;
+			auto push = [&](const u8* row) {
+				if (o == r.rows())
+					throw std::runtime_error("UbPsi: a removed item is not in the table. " LOCATION);
+				memcpy(r[o++].data(), row, maskSize);
+			};
+
+			while (i < table.rows())
+			{
+				if (j < removed.rows())
+				{
+					auto c = memcmp(removed[j].data(), table[i].data(), maskSize);
+					if (c < 0)
+						throw std::runtime_error("UbPsi: a removed item is not in the table. " LOCATION);
+					if (c == 0)
+					{
+						++i, ++j;
+						continue;
+					}
+				}
+
+				if (k < added.rows() && memcmp(added[k].data(), table[i].data(), maskSize) < 0)
+					push(added[k++].data());
+				else
+					push(table[i++].data());
+			}
+
+			if (j != removed.rows())
+				throw std::runtime_error("UbPsi: a removed item is not in the table. " LOCATION);
+
+			while (k < added.rows())
+				push(added[k++].data());
+
+			return r;
+		}
+	}
+
+	void details::UbPsiBase::init(
+		u64 serverSize,
+		u64 maxClientSize,
+		u64 statSecParam,
+		block seed,
+		u64 numThreads)
+	{
+		mServerSize = serverSize;
+		mMaxClientSize = maxClientSize;
+		mSsp = statSecParam;
+		mPrng.SetSeed(seed);
+		mNumThreads = numThreads;
+		mVersion = 0;
+
+		mMaskSize = std::min<u64>(
+			oc::divCeil(mSsp + oc::log2ceil(mServerSize * mMaxClientSize), 8),
+			sizeof(block));
+	}
+
+	void UbPsiSender::init(u64 serverSize, u64 maxClientSize, u64 statSecParam, block seed, u64 numThreads)
+	{
+		details::UbPsiBase::init(serverSize, maxClientSize, statSecParam, seed, numThreads);
+		mKey = Number(mPrng);
+		mTable = {};
+		mAddedRows = {};
+		mRemovedRows = {};
+	}
+
+	void UbPsiSender::preprocess(span<const block> inputs)
+	{
+		setTimePoint("UbPsiSender::preprocess-begin");
+		if (inputs.size() != mServerSize)
+			throw RTE_LOC;
+
+		mTable = sortedTable(inputs, mKey, mMaskSize, mNumThreads);
+		mAddedRows = {};
+		mRemovedRows = {};
+		mVersion = 1;
+
+		setTimePoint("UbPsiSender::preprocess-end");
+	}
+
+	void UbPsiSender::update(span<const block> added, span<const block> removed)
+	{
+		setTimePoint("UbPsiSender::update-begin");
+		if (!mVersion)
+			throw std::runtime_error("UbPsiSender::preprocess(...) must be called before update(...). " LOCATION);
+
+		mAddedRows = sortedTable(added, mKey, mMaskSize, mNumThreads);
+		mRemovedRows = sortedTable(removed, mKey, mMaskSize, mNumThreads);
+		setTimePoint("UbPsiSender::update-eval");
+
+		mTable = applyDelta(mTable, mAddedRows, mRemovedRows, mMaskSize);
+		++mVersion;
+		setTimePoint("UbPsiSender::update-end");
+	}
+
+	Proto UbPsiSender::sendTable(Socket& chl)
+	{
+		if (!mVersion)
+			throw std::runtime_error("UbPsiSender::preprocess(...) must be called before sendTable(...). " LOCATION);
+
+		co_await(chl.send(std::array<u64, 2>{ mVersion, mTable.rows() }));
+		if (mTable.size())
+			co_await(chl.send(span<u8>(mTable.data(), mTable.size())));
+		setTimePoint("UbPsiSender::sendTable");
+	}
+
+	Proto UbPsiSender::sendUpdate(Socket& chl)
+	{
+		if (mVersion < 2)
+			throw std::runtime_error("UbPsiSender::update(...) must be called before sendUpdate(...). " LOCATION);
+
+		co_await(chl.send(std::array<u64, 3>{ mVersion, mAddedRows.rows(), mRemovedRows.rows() }));
+		if (mAddedRows.size())
+			co_await(chl.send(span<u8>(mAddedRows.data(), mAddedRows.size())));
+		if (mRemovedRows.size())
+			co_await(chl.send(span<u8>(mRemovedRows.data(), mRemovedRows.size())));
+		setTimePoint("UbPsiSender::sendUpdate");
+	}
+
+	Proto UbPsiSender::run(Socket& chl)
+	{
+		auto n = u64{};
+		auto points = std::vector<u8>{};
+
+		setTimePoint("UbPsiSender::run-begin");
+
+		co_await(chl.recv(n));
+		if (n > mMaxClientSize)
+			throw std::runtime_error("UbPsiSender: the client set is larger than maxClientSize. " LOCATION);
+
+		// a runDelta(...) without added items.
+		if (n == 0)
+			co_return;
+
+		points.resize(n * Point::size);
+		co_await(chl.recv(points));
+		setTimePoint("UbPsiSender::run-recv");
+
+		// k * r * H'(x)
+		parallelFor(n, mNumThreads, [&](u64 begin, u64 end) {
+			for (u64 i = begin; i < end; ++i)
+			{
+				Point p;
+				p.fromBytes(&points[i * Point::size]);
+				p = p * mKey;
+				p.toBytes(&points[i * Point::size]);
+			}
+		});
+		setTimePoint("UbPsiSender::run-eval");
+
+		co_await(chl.send(std::move(points)));
+		setTimePoint("UbPsiSender::run-send");
+	}
+
+	Proto UbPsiReceiver::receiveTable(Socket& chl)
+	{
+		auto sizes = std::array<u64, 2>{};
+		auto i = u64{};
+
+		setTimePoint("UbPsiReceiver::receiveTable-begin");
+		co_await(chl.recv(sizes));
+		mTable.resize(sizes[1], mMaskSize, oc::AllocType::Uninitialized);
+		if (mTable.size())
+			co_await(chl.recv(span<u8>(mTable.data(), mTable.size())));
+		mVersion = sizes[0];
+		setTimePoint("UbPsiReceiver::receiveTable-recv");
+
+		// a new table, e.g. after missing an update.
+		for (i = 0; i < mItems.size(); ++i)
+			updateItem(mItems[i]);
+	}
+
+	Proto UbPsiReceiver::receiveUpdate(Socket& chl)
+	{
+		auto sizes = std::array<u64, 3>{};
+		auto added = Matrix<u8>{};
+		auto removed = Matrix<u8>{};
+		auto i = u64{};
+		auto h = (const u8*)nullptr;
+
+		setTimePoint("UbPsiReceiver::receiveUpdate-begin");
+		co_await(chl.recv(sizes));
+		added.resize(sizes[1], mMaskSize, oc::AllocType::Uninitialized);
+		removed.resize(sizes[2], mMaskSize, oc::AllocType::Uninitialized);
+		if (added.size())
+			co_await(chl.recv(span<u8>(added.data(), added.size())));
+		if (removed.size())
+			co_await(chl.recv(span<u8>(removed.data(), removed.size())));
+		setTimePoint("UbPsiReceiver::receiveUpdate-recv");
+
+		if (!mVersion || sizes[0] != mVersion + 1)
+			throw std::runtime_error("UbPsiReceiver: missed a server update, call receiveTable(...) instead. " LOCATION);
+
+		mTable = applyDelta(mTable, added, removed, mMaskSize);
+		mVersion = sizes[0];
+
+		// only the items whose output was added or removed can change.
+		for (i = 0; i < mItems.size(); ++i)
+		{
+			h = (const u8*)&mItems[i].mHash;
+			if (contains(added, h, mMaskSize) || contains(removed, h, mMaskSize))
+				updateItem(mItems[i]);
+		}
+		setTimePoint("UbPsiReceiver::receiveUpdate-end");
+	}
+
+	Proto UbPsiReceiver::eval(span<const block> inputs, std::vector<block>& hashes, Socket& chl)
+	{
+		auto n = u64{};
+		auto blinds = std::vector<Number>{};
+		auto points = std::vector<u8>{};
+		auto evals = std::vector<u8>{};
+		auto i = u64{};
+
+		n = inputs.size();
+		hashes.assign(n, oc::ZeroBlock);
+
+		blinds.reserve(n);
+		for (i = 0; i < n; ++i)
+			blinds.emplace_back(mPrng);
+
+		// r * H'(x)
+		points.resize(n * Point::size);
+		parallelFor(n, mNumThreads, [&](u64 begin, u64 end) {
+			for (u64 j = begin; j < end; ++j)
+			{
+				auto p = hashToPoint(inputs[j]) * blinds[j];
+				p.toBytes(&points[j * Point::size]);
+				blinds[j] = blinds[j].inverse();
+			}
+		});
+		setTimePoint("UbPsiReceiver::eval-blind");
+
+		co_await(chl.send(std::move(n)));
+		if (inputs.empty())
+			co_return;
+
+		co_await(chl.send(std::move(points)));
+
+		evals.resize(inputs.size() * Point::size);
+		co_await(chl.recv(evals));
+		setTimePoint("UbPsiReceiver::eval-recv");
+
+		// unblind and hash k * H'(x).
+		parallelFor(inputs.size(), mNumThreads, [&](u64 begin, u64 end) {
+			for (u64 j = begin; j < end; ++j)
+			{
+				Point p;
+				p.fromBytes(&evals[j * Point::size]);
+				p = p * blinds[j];
+				hashOutput(inputs[j], p, (u8*)&hashes[j], mMaskSize);
+			}
+		});
+		setTimePoint("UbPsiReceiver::eval-unblind");
+	}
+
+	void UbPsiReceiver::updateItem(DeltaItem& item)
+	{
+		auto in = contains(mTable, (const u8*)&item.mHash, mMaskSize);
+		if (in != item.mInIntersection)
+		{
+			item.mInIntersection = in;
+			if (in)
+				mIntersectionAdded.push_back(item.mItem);
+			else
+				mIntersectionRemoved.push_back(item.mItem);
+		}
+	}
+
+	Proto UbPsiReceiver::run(span<const block> inputs, Socket& chl)
+	{
+		auto hashes = std::vector<block>{};
+		auto found = std::vector<u8>{};
+		auto i = u64{};
+
+		setTimePoint("UbPsiReceiver::run-begin");
+
+		if (inputs.size() > mMaxClientSize)
+			throw std::runtime_error("UbPsiReceiver: the input set is larger than maxClientSize. " LOCATION);
+		if (!mVersion)
+			throw std::runtime_error("UbPsiReceiver::receiveTable(...) must be called before run(...). " LOCATION);
+
+		mIntersection.clear();
+
+		co_await(eval(inputs, hashes, chl));
+
+		// look up k * H'(x).
+		found.resize(inputs.size());
+		parallelFor(inputs.size(), mNumThreads, [&](u64 begin, u64 end) {
+			for (u64 j = begin; j < end; ++j)
+				found[j] = contains(mTable, (const u8*)&hashes[j], mMaskSize);
+		});
+		setTimePoint("UbPsiReceiver::run-find");
+
+		for (i = 0; i < found.size(); ++i)
+			if (found[i])
+				mIntersection.push_back(i);
+	}
+
+	Proto UbPsiReceiver::runDelta(span<const block> added, span<const block> removed, Socket& chl)
+	{
+		auto rem = std::vector<block>{};
+		auto hashes = std::vector<block>{};
+		auto i = u64{};
+		auto j = u64{};
+		auto end = u64{};
+		auto less = [](const DeltaItem& a, const DeltaItem& b) { return itemLess(a.mItem, b.mItem); };
+
+		setTimePoint("UbPsiReceiver::runDelta-begin");
+
+		if (!mVersion)
+			throw std::runtime_error("UbPsiReceiver::receiveTable(...) must be called before runDelta(...). " LOCATION);
+		if (removed.size() > mItems.size() || mItems.size() - removed.size() + added.size() > mMaxClientSize)
+			throw std::runtime_error("UbPsiReceiver: the input set is larger than maxClientSize. " LOCATION);
+
+		rem.assign(removed.begin(), removed.end());
+		std::sort(rem.begin(), rem.end(), itemLess);
+		for (i = 0; i < rem.size(); ++i)
+		{
+			if (!std::binary_search(mItems.begin(), mItems.end(), DeltaItem{ rem[i] }, less))
+				throw std::runtime_error("UbPsiReceiver: a removed item is not in the set. " LOCATION);
+		}
+
+		// one pass over the sorted items to take out the removed ones.
+		for (i = 0, j = 0, end = 0; i < mItems.size(); ++i)
+		{
+			if (j < rem.size() && mItems[i].mItem == rem[j])
+			{
+				if (mItems[i].mInIntersection)
+					mIntersectionRemoved.push_back(mItems[i].mItem);
+				++j;
+			}
+			else
+				mItems[end++] = mItems[i];
+		}
+		mItems.resize(end);
+		setTimePoint("UbPsiReceiver::runDelta-remove");
+
+		co_await(eval(added, hashes, chl));
+
+		for (i = 0; i < added.size(); ++i)
+		{
+			mItems.push_back({ added[i], hashes[i], false });
+			updateItem(mItems.back());
+		}
+
+		std::sort(mItems.begin() + end, mItems.end(), less);
+		std::inplace_merge(mItems.begin(), mItems.begin() + end, mItems.end(), less);
+		setTimePoint("UbPsiReceiver::runDelta-end");
+	}
+}
+#endif
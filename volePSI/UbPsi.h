@@ -0,0 +1,133 @@
+#pragma once
+// © 2022 Visa.
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "volePSI/Defines.h"
+#include "cryptoTools/Common/Timer.h"
+
+#ifdef ENABLE_SODIUM
+#include "cryptoTools/Crypto/SodiumCurve.h"
+
+namespace volePSI
+{
+    namespace details
+    {
+        struct UbPsiBase
+        {
+            using Point = oc::Sodium::Rist25519;
+            using Number = oc::Sodium::Prime25519;
+
+            u64 mServerSize = 0;
+            u64 mMaxClientSize = 0;
+            u64 mSsp = 0;
+            PRNG mPrng;
+            u64 mNumThreads = 0;
+            u64 mMaskSize = 0;
+
+            // The version of the server table, 0 if there is none yet.
+            // Incremented by every update, see UbPsiSender::update(...).
+            u64 mVersion = 0;
+
+            void init(u64 serverSize, u64 maxClientSize, u64 statSecParam, block seed, u64 numThreads);
+        };
+    }
+
+    // Unbalanced PSI for a large static server set and many small clients.
+    // Unlike RsPsi, the OPRF key is long lived. The server hashes its set
+    // once with preprocess(...) into a sorted table of truncated OPRF outputs
+    // which is sent to each client once with sendTable(...). Each session
+    // then only evaluates the (DH) OPRF on the client's blinded points and
+    // therefore costs O(client set size).
+    //
+    // Both sets can also be changed incrementally. The server calls
+    // update(...) with its added and removed items and sends only the
+    // changed rows of the table with sendUpdate(...). The client keeps
+    // its OPRF outputs across sessions with runDelta(...), which only
+    // evaluates the OPRF on its added items. The cost of a day is then
+    // O(delta) crypto and communication. The client learns which rows
+    // of the table changed.
+    class UbPsiSender : public details::UbPsiBase, public oc::TimerAdapter
+    {
+    public:
+        Number mKey;
+
+        // The sorted truncated OPRF outputs of the server set.
+        Matrix<u8> mTable;
+
+        // The sorted rows added to and removed from mTable by the last update(...).
+        Matrix<u8> mAddedRows, mRemovedRows;
+
+        void init(u64 serverSize, u64 maxClientSize, u64 statSecParam, block seed, u64 numThreads);
+
+        void preprocess(span<const block> inputs);
+
+        // Add and remove items from the server set. The removed items
+        // must be in the set. The mask size is fixed by init(...), so the
+        // set should not grow far beyond serverSize.
+        void update(span<const block> added, span<const block> removed);
+
+        Proto sendTable(Socket& chl);
+
+        // Send the last update to a client that has the previous version.
+        Proto sendUpdate(Socket& chl);
+
+        // Evaluate the OPRF for one run(...) or runDelta(...) of a client.
+        Proto run(Socket& chl);
+    };
+
+    class UbPsiReceiver : public details::UbPsiBase, public oc::TimerAdapter
+    {
+    public:
+
+        // The server's table. Can be kept across sessions with the same server.
+        Matrix<u8> mTable;
+
+        std::vector<u64> mIntersection;
+
+        // A client item and its truncated OPRF output, kept by runDelta(...).
+        struct DeltaItem
+        {
+            block mItem, mHash;
+            bool mInIntersection;
+        };
+
+        // The current client set, sorted by item.
+        std::vector<DeltaItem> mItems;
+
+        // The items that joined or left the intersection since the last
+        // clearDelta(). Filled by runDelta(...) and receiveUpdate(...).
+        std::vector<block> mIntersectionAdded, mIntersectionRemoved;
+
+        Proto receiveTable(Socket& chl);
+
+        // Apply the server's next update to mTable and mItems.
+        Proto receiveUpdate(Socket& chl);
+
+        Proto run(span<const block> inputs, Socket& chl);
+
+        // Add and remove items from the client set kept in mItems. Only
+        // the added items are sent to the server. The removed items must
+        // be in the set.
+        Proto runDelta(span<const block> added, span<const block> removed, Socket& chl);
+
+        void clearDelta()
+        {
+            mIntersectionAdded.clear();
+            mIntersectionRemoved.clear();
+        }
+
+    private:
+
+        // the truncated OPRF outputs of inputs, zero padded.
+        Proto eval(span<const block> inputs, std::vector<block>& hashes, Socket& chl);
+
+        // look item up in mTable and record if it joined or left the intersection.
+        void updateItem(DeltaItem& item);
+    };
+}
+#endif
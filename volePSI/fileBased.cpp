@@ -1,6 +1,7 @@
 #include "fileBased.h"
 #include "cryptoTools/Crypto/RandomOracle.h"
 #include "RsPsi.h"
+#include "RsPsiServer.h"
 
 #include "coproto/Socket/AsioSocket.h"
 
@@ -120,25 +121,9 @@ namespace volePSI
         return ret;
     }
 
-    template<typename InputIterator >
-    void counting_sort(InputIterator first, InputIterator last, u64 endIndex)
-    {
-        using ValueType = typename std::iterator_traits<InputIterator>::value_type;
-        std::vector<u64> counts(endIndex);
-
-        for (auto value = first; value < last; ++value) {
-            ++counts[*value];
-        }
-
-        for (u64 i = 0; i < counts.size(); ++i) {
-            ValueType& value = i;
-            u64& size = counts[i];
-            std::fill_n(first, size, value);
-            std::advance(first, size);
-        }
-    }
-
-    void writeOutput(std::string outPath, FileType ft, const std::vector<u64>& intersection, bool indexOnly, std::string inPath)
+    // Indices is a range of u64 indices, e.g. std::vector<u64> or SetBitRange.
+    template<typename Indices>
+    void writeOutput(std::string outPath, FileType ft, const Indices& intersection, bool indexOnly, std::string inPath)
     {
         std::ofstream file;
 
@@ -155,7 +140,8 @@ namespace volePSI
 
             if (ft == FileType::Bin)
             {
-                file.write((char*)intersection.data(), intersection.size() * sizeof(u64));
+                for (u64 i : intersection)
+                    file.write((char*)&i, sizeof(u64));
             }
             else
             {
@@ -178,9 +164,9 @@ namespace volePSI
                 auto n = size / 16;
                 std::vector<block> fData(n);
                 inFile.read((char*)fData.data(), size);
-                for (u64 i = 0; i < intersection.size(); ++i)
+                for (u64 i : intersection)
                 {
-                    file.write((char*)fData[intersection[i]].data(), sizeof(block));
+                    file.write((char*)fData[i].data(), sizeof(block));
                 }
 
             }
@@ -213,9 +199,9 @@ namespace volePSI
                 if (iter != fData.end())
                     beg.push_back(span<char>(iter, fData.end()));
 
-                for (u64 i = 0; i < intersection.size(); ++i)
+                for (u64 i : intersection)
                 {
-                    auto w = beg[intersection[i]];
+                    auto w = beg[i];
                     file.write(w.data(), w.size());
                     file << '\n';
                 }
@@ -283,6 +269,17 @@ namespace volePSI
             auto isServer = cmd.getOr<int>("server", (int)r);
             if (r != Role::Sender && r != Role::Receiver)
                 throw std::runtime_error("-server tag must be set with value 0 or 1.");
+
+            // with -sessions the sender listens for the receivers.
+            auto sessions = cmd.getOr("sessions", 1ull);
+            if (sessions > 1)
+            {
+                if (r != Role::Sender)
+                    throw std::runtime_error("-sessions is only supported by the sender.");
+                if (cmd.isSet("server") && !isServer)
+                    throw std::runtime_error("-sessions requires the sender to be the server, the receivers must use -server 0.");
+                isServer = 1;
+            }
             oc::Timer timer;
 
             if (!quiet)
@@ -296,60 +293,99 @@ namespace volePSI
 
             if (!quiet)
                 std::cout << "connecting as " << (tls ? "tls " : "") << (isServer ? "server" : "client") << " at address " << ip << std::flush;
-            coproto::Socket chl;
-            auto connBegin = timer.setTimePoint("");
-            if (tls)
-            {
-                std::string CACert = cmd.get<std::string>("CA");
-                auto privateKey = cmd.get<std::string>("sk");
-                auto publicKey = cmd.get<std::string>("pk");
-
-                if (!exist(CACert) || !exist(privateKey) || !exist(privateKey))
+            auto connect = [&]() -> coproto::Socket {
+                if (tls)
                 {
-                    std::cout << "\n";
-                    if (!exist(CACert))
-                        std::cout << "CA cert " << CACert << " does not exist" << std::endl;
-                    if (!exist(privateKey))
-                        std::cout << "private key " << privateKey << " does not exist" << std::endl;
-                    if (!exist(publicKey))
-                        std::cout << "public key " << publicKey << " does not exist" << std::endl;
-
-                    std::cout << "Please correctly set -CA=<path> -sk=<path> -pk=<path> to the CA cert, user private key "
-                        << " and public key respectively." << std::endl;
-
-                    throw std::runtime_error("bad TLS parameter.");
-                }
+                    std::string CACert = cmd.get<std::string>("CA");
+                    auto privateKey = cmd.get<std::string>("sk");
+                    auto publicKey = cmd.get<std::string>("pk");
+
+                    if (!exist(CACert) || !exist(privateKey) || !exist(privateKey))
+                    {
+                        std::cout << "\n";
+                        if (!exist(CACert))
+                            std::cout << "CA cert " << CACert << " does not exist" << std::endl;
+                        if (!exist(privateKey))
+                            std::cout << "private key " << privateKey << " does not exist" << std::endl;
+                        if (!exist(publicKey))
+                            std::cout << "public key " << publicKey << " does not exist" << std::endl;
+
+                        std::cout << "Please correctly set -CA=<path> -sk=<path> -pk=<path> to the CA cert, user private key "
+                            << " and public key respectively." << std::endl;
+
+                        throw std::runtime_error("bad TLS parameter.");
+                    }
 
 #ifdef COPROTO_ENABLE_OPENSSL
-                boost::asio::ssl::context ctx(!isServer ?
-                    boost::asio::ssl::context::tlsv13_client :
-                    boost::asio::ssl::context::tlsv13_server
-                );
-
-                ctx.set_verify_mode(
-                    boost::asio::ssl::verify_peer |
-                    boost::asio::ssl::verify_fail_if_no_peer_cert);
-                ctx.load_verify_file(CACert);
-                ctx.use_private_key_file(privateKey, boost::asio::ssl::context::file_format::pem);
-                ctx.use_certificate_file(publicKey, boost::asio::ssl::context::file_format::pem);
-
-                chl = coproto::sync_wait(
-                    !isServer ?
-                    macoro::make_task(coproto::AsioTlsConnect(ip, coproto::global_io_context(), ctx)) :
-                    macoro::make_task(coproto::AsioTlsAcceptor(ip, coproto::global_io_context(), ctx))
-                );
+                    boost::asio::ssl::context ctx(!isServer ?
+                        boost::asio::ssl::context::tlsv13_client :
+                        boost::asio::ssl::context::tlsv13_server
+                    );
+
+                    ctx.set_verify_mode(
+                        boost::asio::ssl::verify_peer |
+                        boost::asio::ssl::verify_fail_if_no_peer_cert);
+                    ctx.load_verify_file(CACert);
+                    ctx.use_private_key_file(privateKey, boost::asio::ssl::context::file_format::pem);
+                    ctx.use_certificate_file(publicKey, boost::asio::ssl::context::file_format::pem);
+
+                    return coproto::sync_wait(
+                        !isServer ?
+                        macoro::make_task(coproto::AsioTlsConnect(ip, coproto::global_io_context(), ctx)) :
+                        macoro::make_task(coproto::AsioTlsAcceptor(ip, coproto::global_io_context(), ctx))
+                    );
 #else
-                throw std::runtime_error("COPROTO_ENABLE_OPENSSL must be define (via cmake) to use TLS sockets. " COPROTO_LOCATION);
+                    throw std::runtime_error("COPROTO_ENABLE_OPENSSL must be define (via cmake) to use TLS sockets. " COPROTO_LOCATION);
 #endif
-            }
-            else
-            {
+                }
+                else
+                {
 #ifdef COPROTO_ENABLE_BOOST
-                chl = coproto::asioConnect(ip, isServer);
+                    return coproto::asioConnect(ip, isServer);
 #else
-                throw std::runtime_error("COPROTO_ENABLE_BOOST must be define (via cmake) to use tcp sockets. " COPROTO_LOCATION);
+                    throw std::runtime_error("COPROTO_ENABLE_BOOST must be define (via cmake) to use tcp sockets. " COPROTO_LOCATION);
 #endif
+                }
+            };
+
+            if (sessions > 1)
+            {
+                // serve many receivers with the same set.
+                std::vector<coproto::Socket> chls(sessions);
+                for (u64 i = 0; i < sessions; ++i)
+                    chls[i] = connect();
+
+                if (!quiet)
+                    std::cout << "\nrunning " << sessions << " PSI sessions... " << std::flush;
+
+                RsPsiServer server;
+                server.setMultType(type);
+                server.init(std::move(set), statSetParam, seed, mal, cmd.getOr("nt", 1), cmd.getOr("maxSessions", sessions));
+                server.mMaxRecverSize = cmd.getOr("maxRecverSize", server.mMaxRecverSize);
+                server.run(chls);
+
+                u64 numFailed = 0;
+                for (u64 i = 0; i < sessions; ++i)
+                {
+                    if (server.mSessionErrors[i])
+                    {
+                        ++numFailed;
+                        try { std::rethrow_exception(server.mSessionErrors[i]); }
+                        catch (std::exception& e) {
+                            std::cout << oc::Color::Red << "session " << i << " failed: " << e.what() << std::endl << oc::Color::Default;
+                        }
+                    }
+                    else
+                        macoro::sync_wait(chls[i].flush());
+                }
+
+                if (!quiet)
+                    std::cout << "Done, " << sessions - numFailed << " of " << sessions << " sessions succeeded" << std::endl;
+                return;
             }
+
+            auto connBegin = timer.setTimePoint("");
+            coproto::Socket chl = connect();
             auto connEnd = timer.setTimePoint("");
             if (!quiet)
                 std::cout << ' ' << std::chrono::duration_cast<std::chrono::milliseconds>(connEnd - connBegin).count()
@@ -393,6 +429,11 @@ namespace volePSI
                 recver.mDebug = debug;
                 recver.setMultType(type);
                 recver.init(theirSize, set.size(), statSetParam, seed, mal, 1);
+
+                // the bitmap output is already sorted.
+                if (sortOutput)
+                    recver.mOutput = PsiOutput::Bitmap;
+
                 macoro::sync_wait(recver.run(set, chl));
                 macoro::sync_wait(chl.flush());
 
@@ -403,9 +444,9 @@ namespace volePSI
                     << "ms\nWriting output to " << outPath << std::flush;
 
                 if (sortOutput)
-                    counting_sort(recver.mIntersection.begin(), recver.mIntersection.end(), set.size());
-
-                writeOutput(outPath, ft, recver.mIntersection, indexOnly, path);
+                    writeOutput(outPath, ft, SetBitRange(recver.mIntersectionBitmap), indexOnly, path);
+                else
+                    writeOutput(outPath, ft, recver.mIntersection, indexOnly, path);
 
                 auto outEnd = timer.setTimePoint("");
                 if (!quiet)
@@ -414,7 +455,7 @@ namespace volePSI
 
 
                 if (verbose)
-                    std::cout << "intesection_size = " << recver.mIntersection.size() << std::endl;
+                    std::cout << "intesection_size = " << recver.mCardinality << std::endl;
             }
 
         }